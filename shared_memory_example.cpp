@@ -7,7 +7,9 @@
 #include <vector>
 #include <cstring>
 #include <cstdlib>
+#include <cmath>
 #include <string>
+#include <string_view>
 #include <sys/mman.h>
 #include <sstream>
 #include <atomic>
@@ -17,6 +19,32 @@
 #include <cstdio>
 #include <sys/types.h>
 #include <unistd.h>   // for close()
+#include <algorithm>
+#include <random>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <cctype>
+#include <map>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/vfs.h>
+#include <dirent.h>
+#include <sys/uio.h>
+#include <sys/file.h>
+#include <sys/statvfs.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <condition_variable>
+#include <future>
+#include <deque>
+#include <set>
+#include <numeric>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
 namespace bip = boost::interprocess;
 
@@ -35,6 +63,35 @@ std::string FormatArgs(T&& v, R&&... rest) {
 #define SPD_LOG_INFO(fmt, ...)  do { std::cout << "[INFO]" << fmt << FormatArgs(__VA_ARGS__) << std::endl; } while(0)
 #endif
 
+// === 指标 (Prometheus text format) ===
+// 进程内 gauge 表, 由 watch 循环定期原子写入 METRICS_FILE,
+// 供 node-exporter textfile collector 或 sidecar 抓取.
+class Metrics {
+public:
+    static Metrics& Instance() {
+        static Metrics m;
+        return m;
+    }
+    void Set(const std::string& name, double v, const std::string& labels = "") {
+        std::lock_guard<std::mutex> lk(mu_);
+        gauges_[name][labels] = v;
+    }
+    std::string Render() const {
+        std::lock_guard<std::mutex> lk(mu_);
+        std::ostringstream oss;
+        for (const auto& g : gauges_) {
+            oss << "# TYPE " << g.first << " gauge\n";
+            for (const auto& kv : g.second)
+                oss << g.first << (kv.first.empty() ? "" : "{" + kv.first + "}") << " " << kv.second << "\n";
+        }
+        return oss.str();
+    }
+
+private:
+    mutable std::mutex mu_;
+    std::map<std::string, std::map<std::string, double>> gauges_;
+};
+
 // === Page touch (预热页) ===
 static void TouchPages(const char* base, std::size_t bytes) {
     static const std::size_t kPage = 4096;
@@ -44,226 +101,4907 @@ static void TouchPages(const char* base, std::size_t bytes) {
     }
 }
 
-// === 冻结文件结构 ===
-struct FrozenHeader {
-    char     magic[8];
-    uint32_t version;
-    uint32_t model_cnt;
-    uint32_t bucket_cnt;
-    uint32_t entry_cnt;
-    uint32_t val_pool_sz;
+// === XXH64 (内容校验) ===
+// 标准 XXH64 (seed 可选), 支持流式 Update, 用于 manifest / 分段校验和.
+class Xxh64 {
+public:
+    explicit Xxh64(uint64_t seed = 0) { Reset(seed); }
+
+    void Reset(uint64_t seed = 0) {
+        seed_ = seed;
+        v_[0] = seed + kP1 + kP2;
+        v_[1] = seed + kP2;
+        v_[2] = seed;
+        v_[3] = seed - kP1;
+        total_ = 0;
+        buf_len_ = 0;
+    }
+
+    void Update(const void* data, std::size_t len) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        total_ += len;
+        if (buf_len_) {
+            std::size_t n = std::min<std::size_t>(32 - buf_len_, len);
+            std::memcpy(buf_ + buf_len_, p, n);
+            buf_len_ += n;
+            p += n;
+            len -= n;
+            if (buf_len_ < 32) return;
+            Stripe(buf_);
+            buf_len_ = 0;
+        }
+        // 累加器放寄存器: 经 char 指针读入会被视为可能别名 v_
+        uint64_t v0 = v_[0], v1 = v_[1], v2 = v_[2], v3 = v_[3];
+        for (; len >= 32; p += 32, len -= 32) {
+            v0 = Round(v0, Read64(p));
+            v1 = Round(v1, Read64(p + 8));
+            v2 = Round(v2, Read64(p + 16));
+            v3 = Round(v3, Read64(p + 24));
+        }
+        v_[0] = v0, v_[1] = v1, v_[2] = v2, v_[3] = v3;
+        if (len) {
+            std::memcpy(buf_, p, len);
+            buf_len_ = len;
+        }
+    }
+
+    uint64_t Digest() const {
+        uint64_t h;
+        if (total_ >= 32) {
+            h = Rotl(v_[0], 1) + Rotl(v_[1], 7) + Rotl(v_[2], 12) + Rotl(v_[3], 18);
+            for (uint64_t v : v_) h = (h ^ Round(0, v)) * kP1 + kP4;
+        } else {
+            h = seed_ + kP5;
+        }
+        h += total_;
+        const unsigned char* p = buf_;
+        std::size_t len = buf_len_;
+        for (; len >= 8; p += 8, len -= 8) h = Rotl(h ^ Round(0, Read64(p)), 27) * kP1 + kP4;
+        if (len >= 4) {
+            h = Rotl(h ^ (uint64_t(Read32(p)) * kP1), 23) * kP2 + kP3;
+            p += 4;
+            len -= 4;
+        }
+        for (; len; ++p, --len) h = Rotl(h ^ (*p * kP5), 11) * kP1;
+        h ^= h >> 33;
+        h *= kP2;
+        h ^= h >> 29;
+        h *= kP3;
+        h ^= h >> 32;
+        return h;
+    }
+
+    static uint64_t Hash(const void* data, std::size_t len, uint64_t seed = 0) {
+        Xxh64 x(seed);
+        x.Update(data, len);
+        return x.Digest();
+    }
+
+private:
+    static constexpr uint64_t kP1 = 11400714785074694791ULL;
+    static constexpr uint64_t kP2 = 14029467366897019727ULL;
+    static constexpr uint64_t kP3 = 1609587929392839161ULL;
+    static constexpr uint64_t kP4 = 9650029242287828579ULL;
+    static constexpr uint64_t kP5 = 2870177450012600261ULL;
+
+    static uint64_t Rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+    static uint64_t Read64(const unsigned char* p) { uint64_t v; std::memcpy(&v, p, 8); return v; }
+    static uint32_t Read32(const unsigned char* p) { uint32_t v; std::memcpy(&v, p, 4); return v; }
+    static uint64_t Round(uint64_t acc, uint64_t in) { return Rotl(acc + in * kP2, 31) * kP1; }
+    void Stripe(const unsigned char* p) {
+        for (int i = 0; i < 4; ++i) v_[i] = Round(v_[i], Read64(p + 8 * i));
+    }
+
+    uint64_t seed_ = 0;
+    uint64_t v_[4];
+    uint64_t total_ = 0;
+    unsigned char buf_[32];
+    std::size_t buf_len_ = 0;
 };
-using Header = FrozenHeader;  // 兼容引用代码
-struct Model { uint32_t model_id; uint32_t version; };
-struct Entry { uint32_t key_hash; uint32_t value_offset; uint32_t value_size; };
 
-// === Loader ===
-#ifdef __GNUC__
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wunused-variable"
+// === 存储访问层 (FileAccess) ===
+// 加载后端 / 本地缓存回填 / writer 流式写经 FileAccess 读写数据文件, 默认直接走系统调用.
+// 设置 STORAGE_SIM_PATH 后, 该前缀下的文件改走 SimulatedAccess, 在本地文件上复现 blobfuse 的代价:
+//   - 每个请求一次往返 latency (FUSE 用户态往返 + 远端 GET/PUT);
+//   - 单次请求最多 request_bytes (direct_io 下内核按 max_read/max_write 拆分), 调用方循环续读/续写;
+//   - 进程内共享 bandwidth_bps 链路, 同时在途请求数上限 inflight (FUSE max_background);
+//   - mmap 预热按 fault_bytes 粒度缺页, 每次缺页一次往返 (零缓存时没有 readahead 合并).
+// 只加延迟不改数据, 校验与格式路径与真实挂载一致. 元数据操作 (open/stat/rename) 不计费.
+struct StorageSimOptions {
+    std::string path;                      // 模拟前缀, 空 = 关闭
+    uint64_t latency_us = 2000;
+    uint64_t bandwidth_bps = 0;            // 0 = 不限
+    uint64_t request_bytes = 128ull << 10;
+    uint64_t fault_bytes = 4096;
+    uint32_t inflight = 0;                 // 0 = 不限
+};
+
+class FileAccess {
+public:
+    virtual ~FileAccess() = default;
+    virtual const char* name() const { return "local"; }
+    virtual bool Simulated() const { return false; }
+    // 语义同 pread/pwrite, 允许短读写
+    virtual ssize_t Pread(int fd, void* buf, size_t n, uint64_t off) const { return ::pread(fd, buf, n, (off_t)off); }
+    virtual ssize_t Pwrite(int fd, const void* buf, size_t n, uint64_t off) const {
+        return ::pwrite(fd, buf, n, (off_t)off);
+    }
+    // 映射区间 len 字节即将缺页载入; 本地文件由内核处理, 无额外代价
+    virtual void Fault(uint64_t /*len*/) const {}
+
+    static const FileAccess& Local();
+    // path 落在 STORAGE_SIM_PATH 前缀下时返回模拟后端; 进程启动时 Configure 一次, 之后只读
+    static const FileAccess& For(const std::string& path);
+    static void Configure(const StorageSimOptions& opt);
+    static void ExportMetrics();
+};
+
+class SimulatedAccess : public FileAccess {
+public:
+    explicit SimulatedAccess(const StorageSimOptions& opt) : opt_(opt) {
+        opt_.request_bytes = std::max<uint64_t>(4096, opt_.request_bytes & ~4095ull);
+        opt_.fault_bytes = std::max<uint64_t>(4096, opt_.fault_bytes & ~4095ull);
+    }
+    const char* name() const override { return "sim"; }
+    bool Simulated() const override { return true; }
+    const StorageSimOptions& Options() const { return opt_; }
+
+    ssize_t Pread(int fd, void* buf, size_t n, uint64_t off) const override {
+        ssize_t r = ::pread(fd, buf, std::min<uint64_t>(n, opt_.request_bytes), (off_t)off);
+        Request(r > 0 ? (uint64_t)r : 0);
+        return r;
+    }
+    ssize_t Pwrite(int fd, const void* buf, size_t n, uint64_t off) const override {
+        ssize_t r = ::pwrite(fd, buf, std::min<uint64_t>(n, opt_.request_bytes), (off_t)off);
+        Request(r > 0 ? (uint64_t)r : 0);
+        return r;
+    }
+    // 缺页阻塞当前线程, 同一线程内的缺页串行
+    void Fault(uint64_t len) const override {
+        for (uint64_t off = 0; off < len; off += opt_.fault_bytes) Request(std::min(opt_.fault_bytes, len - off));
+    }
+
+    uint64_t Requests() const { return requests_.load(); }
+    uint64_t Bytes() const { return bytes_.load(); }
+    double DelaySeconds() const { return delay_ns_.load() / 1e9; }
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    // 一次往返: 等待在途名额, latency 后在共享链路上按带宽传输 bytes, 睡到完成时刻
+    void Request(uint64_t bytes) const {
+        if (opt_.inflight) {
+            std::unique_lock<std::mutex> lk(mu_);
+            cv_.wait(lk, [&] { return busy_ < opt_.inflight; });
+            ++busy_;
+        }
+        auto t0 = clock::now();
+        auto done = t0 + std::chrono::microseconds(opt_.latency_us);
+        if (opt_.bandwidth_bps && bytes) {
+            auto xfer = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(double(bytes) / opt_.bandwidth_bps));
+            std::lock_guard<std::mutex> lk(mu_);
+            link_free_ = std::max(link_free_, done) + xfer;
+            done = link_free_;
+        }
+        std::this_thread::sleep_until(done);
+        if (opt_.inflight) {
+            {
+                std::lock_guard<std::mutex> lk(mu_);
+                --busy_;
+            }
+            cv_.notify_one();
+        }
+        requests_.fetch_add(1, std::memory_order_relaxed);
+        bytes_.fetch_add(bytes, std::memory_order_relaxed);
+        delay_ns_.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - t0).count(),
+                            std::memory_order_relaxed);
+    }
+
+    StorageSimOptions opt_;
+    mutable std::mutex mu_;
+    mutable std::condition_variable cv_;
+    mutable uint32_t busy_{0};
+    mutable clock::time_point link_free_{};
+    mutable std::atomic<uint64_t> requests_{0}, bytes_{0}, delay_ns_{0};
+};
+
+static std::unique_ptr<SimulatedAccess>& StorageSim() {
+    static std::unique_ptr<SimulatedAccess> sim;
+    return sim;
+}
+
+inline const FileAccess& FileAccess::Local() {
+    static const FileAccess local;
+    return local;
+}
+
+inline const FileAccess& FileAccess::For(const std::string& path) {
+    const SimulatedAccess* sim = StorageSim().get();
+    if (!sim) return Local();
+    const std::string& root = sim->Options().path;
+    bool under = path.compare(0, root.size(), root) == 0 &&
+                 (path.size() == root.size() || root.back() == '/' || path[root.size()] == '/');
+    return under ? static_cast<const FileAccess&>(*sim) : Local();
+}
+
+inline void FileAccess::Configure(const StorageSimOptions& opt) {
+    if (opt.path.empty()) return;
+    StorageSim() = std::make_unique<SimulatedAccess>(opt);
+    const StorageSimOptions& o = StorageSim()->Options();
+    LOG_INFO << "[sim] simulating remote storage under " << o.path << " latency=" << o.latency_us << "us"
+             << " bandwidth=" << (o.bandwidth_bps >> 20) << "MiB/s request=" << (o.request_bytes >> 10) << "KiB"
+             << " fault=" << (o.fault_bytes >> 10) << "KiB inflight=" << o.inflight << std::endl;
+}
+
+inline void FileAccess::ExportMetrics() {
+    const SimulatedAccess* sim = StorageSim().get();
+    if (!sim) return;
+    Metrics::Instance().Set("frozen_sim_requests", double(sim->Requests()));
+    Metrics::Instance().Set("frozen_sim_bytes", double(sim->Bytes()));
+    Metrics::Instance().Set("frozen_sim_delay_seconds", sim->DelaySeconds());
+}
+
+// === 并行分块预取 ===
+// 区域切成 chunk_bytes 大块, threads 个线程领取并行缺页; 每块优先 MADV_POPULATE_READ
+// (5.14+), 内核不支持 (EINVAL) 时退回 MADV_WILLNEED + TouchPages. bandwidth_bps
+// 为全局限速, 按已领取字节数统一配速.
+#ifndef MADV_POPULATE_READ
+#define MADV_POPULATE_READ 22
+#endif
+#ifndef MADV_COLD
+#define MADV_COLD 20
+#endif
+#ifndef MADV_PAGEOUT
+#define MADV_PAGEOUT 21
 #endif
 
-// 移除 MMapFile，直接使用 boost::interprocess
-class FrozenHashMapImpl {
+template <typename Fn>
+static void ParallelFor(uint32_t threads, Fn&& fn) {
+    std::vector<std::thread> workers;
+    for (uint32_t t = 1; t < threads; ++t) workers.emplace_back(fn, t);
+    fn(0u);
+    for (auto& w : workers) w.join();
+}
+
+// 校验单元: [off, off + len) 的期望 XXH64 (来自 STRATSEG 段表或 STRATSUM 校验尾);
+// 其后 extra 字节只随单元一起读入, 不参与 hash (校验尾自身, 由其 self_hash 保护)
+struct VerifyUnit { uint64_t off; uint64_t len; uint64_t hash; uint64_t extra = 0; };
+
+struct PrefetchOptions {
+    uint32_t threads       = 4;
+    uint64_t chunk_bytes   = 64ull << 20;
+    uint64_t bandwidth_bps = 0;   // 0 = 不限速
+    std::function<void(uint64_t done, uint64_t total)> progress;  // 串行回调
+    // 非空时按校验单元领取: 同一线程读入/缺页后立即算 hash 比对, 不另起校验遍
+    const std::vector<VerifyUnit>* verify = nullptr;
+};
+
+struct PrefetchStats {
+    uint64_t bytes = 0;
+    double seconds = 0;
+    bool populate_read = false;
+    uint64_t verified = 0;   // 校验通过的字节数
+    bool corrupt = false;    // 有单元 hash 不符
+    double GiBps() const { return seconds > 0 ? bytes / seconds / (1ull << 30) : 0; }
+};
+
+using ByteRange = std::pair<uint64_t, uint64_t>;  // (offset, len)
+
+class PrefetchEngine {
 public:
-    bool Build(const std::string& file) {
-        auto begin = std::chrono::system_clock::now();
-        file_path_ = file;
+    // cancel 置位时尽快返回 false; 缺页失败 (EIO/EFAULT) 同样返回 false.
+    // io: 映射文件所在存储, 每块缺页前由它计入模拟代价 (本地为空操作)
+    static bool Run(const char* base, uint64_t len, const PrefetchOptions& opt,
+                    const std::atomic<bool>* cancel, PrefetchStats* stats, const FileAccess& io = FileAccess::Local()) {
+        return RunRanges(base, {ByteRange{0, len}}, opt, cancel, stats, io);
+    }
+
+    // 只预取给定区间 (增量预热: 由 ResidencyTracker 给出缺页区间)
+    static bool RunRanges(const char* base, const std::vector<ByteRange>& ranges, const PrefetchOptions& opt,
+                          const std::atomic<bool>* cancel, PrefetchStats* stats,
+                          const FileAccess& io = FileAccess::Local()) {
+        bool ok = RunChunks(ranges, opt, cancel, stats, [base, &io](uint64_t off, uint64_t n) {
+            io.Fault(n);
+            return FaultIn(base + off, n);
+        });
+        if (stats) stats->populate_read = populate_ok_.load() == 1;
+        return ok;
+    }
+
+    // 通用分块调度: 领取/限速/进度, 每块调用 fn(off, n) -> bool (加载后端复用)
+    template <typename ChunkFn>
+    static bool RunChunks(uint64_t len, const PrefetchOptions& opt,
+                          const std::atomic<bool>* cancel, PrefetchStats* stats, ChunkFn&& fn) {
+        return RunChunks(std::vector<ByteRange>{ByteRange{0, len}}, opt, cancel, stats, std::forward<ChunkFn>(fn));
+    }
+
+    template <typename ChunkFn>
+    static bool RunChunks(const std::vector<ByteRange>& ranges, const PrefetchOptions& opt,
+                          const std::atomic<bool>* cancel, PrefetchStats* stats, ChunkFn&& fn) {
+        const uint64_t chunk = std::max<uint64_t>(opt.chunk_bytes & ~4095ull, 4096);
+        std::vector<ByteRange> chunks;
+        for (const auto& r : ranges) {
+            for (uint64_t off = r.first; off < r.first + r.second; off += chunk)
+                chunks.emplace_back(off, std::min(chunk, r.first + r.second - off));
+        }
+        return RunList(chunks, opt, cancel, stats, [&](size_t, uint64_t off, uint64_t n) { return fn(off, n); });
+    }
+
+    // 融合校验: 每个单元先 fetch (缺页 / 读入) 再由同一线程算 XXH64, 数据还在 cache 里.
+    // 不符时记 stats->corrupt 并返回 false, 调用方据此拒绝该版本.
+    template <typename FetchFn>
+    static bool RunVerified(const char* base, const std::vector<VerifyUnit>& units, const PrefetchOptions& opt,
+                            const std::atomic<bool>* cancel, PrefetchStats* stats, FetchFn&& fetch) {
+        std::vector<ByteRange> list;
+        for (const auto& u : units) list.emplace_back(u.off, u.len + u.extra);
+        std::atomic<uint64_t> verified{0};
+        std::atomic<bool> corrupt{false};
+        bool ok = RunList(list, opt, cancel, stats, [&](size_t i, uint64_t off, uint64_t n) {
+            if (!fetch(off, n)) return false;
+            const VerifyUnit& u = units[i];
+            uint64_t got = Xxh64::Hash(base + off, u.len);
+            if (got != u.hash) {
+                LOG_ERROR << "[verify] checksum mismatch off=" << off << " len=" << u.len << " got=" << std::hex << got
+                          << " want=" << u.hash << std::dec << std::endl;
+                corrupt = true;
+                return false;
+            }
+            verified += u.len;
+            return true;
+        });
+        if (stats) {
+            stats->verified = verified.load();
+            stats->corrupt = corrupt.load();
+        }
+        return ok;
+    }
+    static bool RunVerified(const char* base, const std::vector<VerifyUnit>& units, const PrefetchOptions& opt,
+                            const std::atomic<bool>* cancel, PrefetchStats* stats, const FileAccess& io) {
+        bool ok = RunVerified(base, units, opt, cancel, stats, [base, &io](uint64_t off, uint64_t n) {
+            io.Fault(n);
+            return FaultIn(base + off, n);
+        });
+        if (stats) stats->populate_read = populate_ok_.load() == 1;
+        return ok;
+    }
+
+    // 调度已切好的块列表 (不再拆分), fn(i, off, n) -> bool
+    template <typename ChunkFn>
+    static bool RunList(const std::vector<ByteRange>& chunks, const PrefetchOptions& opt,
+                        const std::atomic<bool>* cancel, PrefetchStats* stats, ChunkFn&& fn) {
+        using clock = std::chrono::steady_clock;
+        std::vector<uint64_t> before;  // 该块之前的累计字节, 用于配速
+        uint64_t total = 0;
+        for (const auto& c : chunks) {
+            before.push_back(total);
+            total += c.second;
+        }
+        const uint32_t threads = (uint32_t)std::max<uint64_t>(1, std::min<uint64_t>(opt.threads, chunks.size()));
+        std::atomic<uint64_t> next{0}, done{0};
+        std::atomic<bool> failed{false};
+        std::mutex progress_mu;
+        auto start = clock::now();
+
+        ParallelFor(threads, [&](uint32_t) {
+            for (;;) {
+                if (failed || (cancel && cancel->load(std::memory_order_relaxed))) return;
+                uint64_t i = next.fetch_add(1);
+                if (i >= chunks.size()) return;
+                Pace(start, before[i], opt.bandwidth_bps);
+                if (!fn(i, chunks[i].first, chunks[i].second)) {
+                    failed = true;
+                    return;
+                }
+                uint64_t d = done.fetch_add(chunks[i].second) + chunks[i].second;
+                if (opt.progress) {
+                    std::lock_guard<std::mutex> lk(progress_mu);
+                    opt.progress(d, total);
+                }
+            }
+        });
+        if (stats) {
+            stats->bytes = done.load();
+            stats->seconds = std::chrono::duration<double>(clock::now() - start).count();
+        }
+        return !failed && done.load() == total;
+    }
+
+    // 按全局预算配速: 第 off 字节不早于 start + off / bps 发出
+    static void Pace(std::chrono::steady_clock::time_point start, uint64_t off, uint64_t bps) {
+        if (!bps) return;
+        std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(double(off) / bps)));
+    }
+
+private:
+    static bool FaultIn(const char* p, uint64_t n) {
+        char* q = const_cast<char*>(p);
+        if (populate_ok_.load(std::memory_order_relaxed) != 0) {
+            if (::madvise(q, n, MADV_POPULATE_READ) == 0) {
+                populate_ok_ = 1;
+                return true;
+            }
+            if (errno != EINVAL) {
+                LOG_ERROR << "MADV_POPULATE_READ fail err=" << strerror(errno) << std::endl;
+                return false;
+            }
+            populate_ok_ = 0;
+        }
+        ::madvise(q, n, MADV_WILLNEED);
+        TouchPages(p, n);
+        return true;
+    }
+
+    // -1 = 未探测, 0 = 不支持, 1 = 可用
+    static inline std::atomic<int> populate_ok_{-1};
+};
+
+// === 常驻追踪 (mincore) ===
+// 一次扫描整个映射, 按段 (models/buckets/entries/value_pool) 统计常驻页,
+// 并给出缺页区间 (页对齐, 间隔 < kMergeGap 的区间合并) 供增量预热.
+struct TableSection {
+    const char* name;
+    uint64_t offset;
+    uint64_t len;
+};
+
+struct SectionResidency {
+    std::string name;
+    uint64_t pages = 0;
+    uint64_t resident = 0;
+    double Ratio() const { return pages ? double(resident) / pages : 0.0; }
+};
+
+class ResidencyTracker {
+public:
+    static const uint64_t kPage = 4096;
+    static const uint64_t kMergeGap = 256 << 10;
+
+    bool Scan(const char* base, uint64_t len) {
+        pages_.assign((len + kPage - 1) / kPage, 0);
+        static const uint64_t kStep = 64ull << 20;
+        for (uint64_t off = 0; off < len; off += kStep) {
+            if (::mincore(const_cast<char*>(base + off), std::min(kStep, len - off), &pages_[off / kPage]) != 0)
+                return false;
+        }
+        len_ = len;
+        return true;
+    }
+
+    SectionResidency Section(const TableSection& s) const {
+        SectionResidency r;
+        r.name = s.name;
+        if (s.len == 0) return r;
+        uint64_t p0 = s.offset / kPage, p1 = std::min<uint64_t>((s.offset + s.len + kPage - 1) / kPage, pages_.size());
+        for (uint64_t p = p0; p < p1; ++p) r.resident += pages_[p] & 1;
+        r.pages = p1 > p0 ? p1 - p0 : 0;
+        return r;
+    }
+
+    SectionResidency Total() const { return Section(TableSection{"total", 0, len_}); }
+
+    std::vector<ByteRange> Missing() const {
+        std::vector<ByteRange> out;
+        for (uint64_t p = 0; p < pages_.size();) {
+            if (pages_[p] & 1) { ++p; continue; }
+            uint64_t q = p;
+            while (q < pages_.size() && !(pages_[q] & 1)) ++q;
+            uint64_t off = p * kPage, end = std::min(q * kPage, len_);
+            if (!out.empty() && off - (out.back().first + out.back().second) < kMergeGap)
+                out.back().second = end - out.back().first;
+            else
+                out.emplace_back(off, end - off);
+            p = q;
+        }
+        return out;
+    }
+
+private:
+    std::vector<unsigned char> pages_;
+    uint64_t len_ = 0;
+};
+
+// === 加载后端 ===
+// FrozenHashMapImpl 只看到 [data(), data()+size()) 的只读表视图:
+//   mmap  : boost file_mapping + mapped_region, Populate = PrefetchEngine 缺页预热;
+//   pread : 多线程大块 pread 到匿名内存 (可选 2 MiB 大页), 读完 mprotect 只读;
+//   uring : 同 pread, 但由单线程 io_uring 保持 queue_depth 个大块读在途.
+// Open 之后 Validate 之前, 非 mmap 后端只保证前 kHeadBytes 已就绪 (header + models).
+// === 大页缓冲 ===
+// hugetlb: MAP_HUGETLB 预留 2 MiB 页, 池不足时 mmap 直接失败 -> 退回 THP;
+// thp    : 按 2 MiB 对齐的匿名映射 + MADV_HUGEPAGE, 由缺页/khugepaged 决定能拿到多少;
+// 实际大页数通过 /proc/self/smaps 的 AnonHugePages / Private_Hugetlb 统计.
+enum class HugePageMode { kOff, kThp, kHugetlb };
+
+static HugePageMode ParseHugePageMode(const std::string& v) {
+    if (v == "hugetlb" || v == "auto") return HugePageMode::kHugetlb;
+    if (v == "thp" || v == "1") return HugePageMode::kThp;
+    if (v != "off" && v != "0" && !v.empty()) LOG_ERROR << "unknown LOAD_HUGEPAGES " << v << ", use off" << std::endl;
+    return HugePageMode::kOff;
+}
+
+struct HugeBuffer {
+    char* ptr = nullptr;
+    uint64_t len = 0;
+    HugePageMode got = HugePageMode::kOff;
+};
+
+static const uint64_t kHugePage = 2ull << 20;
+
+static bool AllocHugeBuffer(uint64_t size, HugePageMode mode, HugeBuffer* out) {
+    const uint64_t len = std::max<uint64_t>((size + kHugePage - 1) & ~(kHugePage - 1), kHugePage);
+#ifdef MAP_HUGETLB
+    if (mode == HugePageMode::kHugetlb) {
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB;
+#ifdef MAP_HUGE_SHIFT
+        flags |= 21 << MAP_HUGE_SHIFT;
+#endif
+        void* p = ::mmap(nullptr, len, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (p != MAP_FAILED) {
+            *out = HugeBuffer{static_cast<char*>(p), len, HugePageMode::kHugetlb};
+            return true;
+        }
+        LOG_INFO << "MAP_HUGETLB unavailable (" << strerror(errno) << "), fallback to THP" << std::endl;
+        mode = HugePageMode::kThp;
+    }
+#endif
+    if (mode == HugePageMode::kOff) {
+        void* p = ::mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) return false;
+        *out = HugeBuffer{static_cast<char*>(p), len, HugePageMode::kOff};
+        return true;
+    }
+    // THP 需要 2 MiB 对齐: 多映射一页再裁掉首尾
+    void* raw = ::mmap(nullptr, len + kHugePage, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) return false;
+    uintptr_t r = reinterpret_cast<uintptr_t>(raw);
+    uintptr_t a = (r + kHugePage - 1) & ~(kHugePage - 1);
+    if (a > r) ::munmap(raw, a - r);
+    if (r + kHugePage > a) ::munmap(reinterpret_cast<void*>(a + len), r + kHugePage - a);
+    char* p = reinterpret_cast<char*>(a);
+    if (::madvise(p, len, MADV_HUGEPAGE) != 0)
+        LOG_INFO << "MADV_HUGEPAGE unavailable (" << strerror(errno) << "), using 4 KiB pages" << std::endl;
+    *out = HugeBuffer{p, len, HugePageMode::kThp};
+    return true;
+}
+
+// [addr, addr+len) 内实际落在 2 MiB 页上的页数
+static uint64_t CountHugePages(const void* addr, uint64_t len) {
+    std::ifstream ifs("/proc/self/smaps");
+    const uintptr_t lo = reinterpret_cast<uintptr_t>(addr), hi = lo + len;
+    uint64_t kb = 0;
+    bool in_range = false;
+    std::string line;
+    while (std::getline(ifs, line)) {
+        if (!line.empty() && std::isxdigit((unsigned char)line[0]) && line.find('-') != std::string::npos) {
+            uintptr_t a = std::strtoull(line.c_str(), nullptr, 16);
+            uintptr_t b = std::strtoull(line.c_str() + line.find('-') + 1, nullptr, 16);
+            in_range = a < hi && b > lo;
+        } else if (in_range && (line.rfind("AnonHugePages:", 0) == 0 || line.rfind("Private_Hugetlb:", 0) == 0)) {
+            kb += std::strtoull(line.c_str() + line.find(':') + 1, nullptr, 10);
+        }
+    }
+    return kb / (kHugePage >> 10);
+}
+
+static const char* HugePageModeName(HugePageMode m) {
+    return m == HugePageMode::kHugetlb ? "hugetlb" : m == HugePageMode::kThp ? "thp" : "off";
+}
+
+struct LoadBackendOptions {
+    std::string kind = "mmap";     // mmap | pread | uring | memfd
+    HugePageMode huge_pages = HugePageMode::kOff;  // 非 off 时 mmap 也改走 pread 读入大页缓冲
+    uint32_t uring_depth = 64;
+    uint64_t uring_block = 1ull << 20;
+    int shared_fd = -1;            // >= 0: 映射其他进程交来的已封存 memfd (接管 fd), 不读文件
+    bool shared_verified = false;  // 交出方已校验过该 memfd 的内容
+};
+
+static bool PreadAll(int fd, void* buf, uint64_t n, uint64_t off, const FileAccess& io = FileAccess::Local()) {
+    char* p = static_cast<char*>(buf);
+    while (n > 0) {
+        ssize_t r = io.Pread(fd, p, n, off);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return false;
+        p += r;
+        off += r;
+        n -= r;
+    }
+    return true;
+}
+
+class LoadBackend {
+public:
+    virtual ~LoadBackend() = default;
+    virtual bool Open(const std::string& path) = 0;
+    virtual bool Populate(const PrefetchOptions& opt, const std::atomic<bool>* cancel, PrefetchStats* stats) = 0;
+    virtual const char* data() const = 0;
+    virtual uint64_t size() const = 0;
+    virtual const char* name() const = 0;
+    // 大页统计 (仅匿名缓冲后端): 实际拿到的 2 MiB 页数, 以及最终生效的模式
+    virtual uint64_t HugePages() const { return 0; }
+    virtual HugePageMode HugeMode() const { return HugePageMode::kOff; }
+    // 可按区间换出 (仅文件映射; 匿名缓冲换出即丢数据)
+    virtual bool Evictable() const { return false; }
+    virtual void Evict(uint64_t /*off*/, uint64_t /*len*/, bool /*hard*/) const {}
+    // 读任意位置的少量元数据 (如文件尾的校验表), 不要求该区间已 Populate
+    virtual bool Peek(uint64_t off, void* out, uint64_t n) const {
+        if (off > size() || n > size() - off) return false;
+        std::memcpy(out, data() + off, n);
+        return true;
+    }
+    // 容器自带的分段校验和 (仅 STRATSEG)
+    virtual bool SegmentSums(std::vector<VerifyUnit>* /*out*/) const { return false; }
+    // 可交给同节点其他进程映射的已封存 memfd, -1 = 不可共享
+    virtual int ShareFd() const { return -1; }
+    // 内容已由加载方校验过 (封存后不可改), 本进程不再重复校验
+    virtual bool Verified() const { return false; }
+    // 重启交接时交给新进程的 fd: 已封存 memfd (*memfd = true) 或被映射的文件; -1 = 匿名缓冲, 交不出
+    virtual int HandoffFd(bool* memfd) const {
+        *memfd = true;
+        return ShareFd();
+    }
+    // 表文件所在存储 (STORAGE_SIM_PATH 下为模拟后端), 文件映射的补充预热据此计入缺页代价
+    virtual const FileAccess& Access() const { return FileAccess::Local(); }
+};
 
+// 增量预热: 只预取 mincore 报告不在内存的页, 已热版本 (blobfuse/page cache 命中) 几乎零成本
+static bool PopulateMissing(const char* data, uint64_t size, const PrefetchOptions& opt,
+                            const std::atomic<bool>* cancel, PrefetchStats* stats, const FileAccess& io) {
+    if (size == 0) return true;
+    ResidencyTracker tracker;
+    if (!tracker.Scan(data, size)) return PrefetchEngine::Run(data, size, opt, cancel, stats, io);
+    std::vector<ByteRange> missing = tracker.Missing();
+    uint64_t bytes = 0;
+    for (const auto& r : missing) bytes += r.second;
+    LOG_INFO << "[prefetch] missing=" << bytes << "/" << size << " bytes in " << missing.size() << " ranges" << std::endl;
+    return PrefetchEngine::RunRanges(data, missing, opt, cancel, stats, io);
+}
+
+class MmapBackend : public LoadBackend {
+public:
+    bool Open(const std::string& path) override {
+        io_ = &FileAccess::For(path);
         try {
-            fmap_   = std::make_unique<bip::file_mapping>(file.c_str(), bip::read_only);
+            fmap_   = std::make_unique<bip::file_mapping>(path.c_str(), bip::read_only);
             region_ = std::make_unique<bip::mapped_region>(*fmap_, bip::read_only);
         } catch (const std::exception& ex) {
-            LOG_ERROR << "boost mmap failed: " << file << " err=" << ex.what() << std::endl;
+            LOG_ERROR << "boost mmap failed: " << path << " err=" << ex.what() << std::endl;
+            return false;
+        }
+        return true;
+    }
+    bool Populate(const PrefetchOptions& opt, const std::atomic<bool>* cancel, PrefetchStats* stats) override {
+        if (opt.verify) return PrefetchEngine::RunVerified(data(), *opt.verify, opt, cancel, stats, *io_);
+        return PopulateMissing(data(), size(), opt, cancel, stats, *io_);
+    }
+    const char* data() const override { return static_cast<const char*>(region_->get_address()); }
+    uint64_t size() const override { return region_->get_size(); }
+    const char* name() const override { return "mmap"; }
+    const FileAccess& Access() const override { return *io_; }
+
+    bool Evictable() const override { return true; }
+    int HandoffFd(bool* memfd) const override {
+        *memfd = false;
+        return fmap_->get_mapping_handle().handle;
+    }
+    // soft: MADV_COLD, 内存压力下优先回收; hard: MADV_PAGEOUT 回收, 再 MADV_DONTNEED 解除本进程映射
+    // 并 POSIX_FADV_DONTNEED 丢掉 page cache (仍被映射的页 fadvise 丢不掉), 让 cgroup 计费立即下降
+    void Evict(uint64_t off, uint64_t len, bool hard) const override {
+        off &= ~4095ull;
+        if (off >= size() || len == 0) return;
+        len = std::min(len, size() - off);
+        char* p = const_cast<char*>(data()) + off;
+        if (!hard) {
+            ::madvise(p, len, MADV_COLD);
+            return;
+        }
+        ::madvise(p, len, MADV_PAGEOUT);
+        ::madvise(p, len, MADV_DONTNEED);
+        ::posix_fadvise(fmap_->get_mapping_handle().handle, (off_t)off, (off_t)len, POSIX_FADV_DONTNEED);
+    }
+
+private:
+    std::unique_ptr<bip::file_mapping>   fmap_;
+    std::unique_ptr<bip::mapped_region>  region_;
+    const FileAccess* io_ = &FileAccess::Local();
+};
+
+class PreadBackend : public LoadBackend {
+public:
+    static constexpr uint64_t kHeadBytes = 2ull << 20;
+
+    explicit PreadBackend(const LoadBackendOptions& opt) : opt_(opt) {}
+    ~PreadBackend() override {
+        if (buf_) ::munmap(buf_, alloc_);
+        if (fd_ >= 0) ::close(fd_);
+    }
+
+    bool Open(const std::string& path) override {
+        io_ = &FileAccess::For(path);
+        fd_ = ::open(path.c_str(), O_RDONLY);
+        struct stat st{};
+        if (fd_ < 0 || ::fstat(fd_, &st) != 0) {
+            LOG_ERROR << "open fail: " << path << " err=" << strerror(errno) << std::endl;
+            return false;
+        }
+        size_ = (uint64_t)st.st_size;
+        if (!Alloc()) return false;
+        head_ = std::min(size_, kHeadBytes);
+        ::posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+        return ReadFully(0, head_);
+    }
+
+    bool Populate(const PrefetchOptions& opt, const std::atomic<bool>* cancel, PrefetchStats* stats) override {
+        bool ok = ReadRest(opt, cancel, stats);
+        if (ok) ::mprotect(buf_, alloc_, PROT_READ);
+        return ok;
+    }
+    const char* data() const override { return buf_; }
+    uint64_t size() const override { return size_; }
+    const char* name() const override { return "pread"; }
+    uint64_t HugePages() const override {
+        return huge_mode_ == HugePageMode::kOff ? 0 : CountHugePages(buf_, alloc_);
+    }
+    HugePageMode HugeMode() const override { return huge_mode_; }
+    bool Peek(uint64_t off, void* out, uint64_t n) const override {
+        if (off > size_ || n > size_ - off) return false;
+        if (off + n <= head_) {
+            std::memcpy(out, buf_ + off, n);
+            return true;
+        }
+        return PreadAll(fd_, out, n, off, *io_);
+    }
+    const FileAccess& Access() const override { return *io_; }
+
+protected:
+    // 分配 size_ 字节的读入缓冲 -> buf_ / alloc_
+    virtual bool Alloc() {
+        HugeBuffer hb;
+        if (!AllocHugeBuffer(size_, opt_.huge_pages, &hb)) {
+            LOG_ERROR << "anonymous alloc fail: " << size_ << " err=" << strerror(errno) << std::endl;
             return false;
         }
+        buf_ = hb.ptr;
+        alloc_ = hb.len;
+        huge_mode_ = hb.got;
+        return true;
+    }
+
+    virtual bool ReadRest(const PrefetchOptions& opt, const std::atomic<bool>* cancel, PrefetchStats* stats) {
+        if (opt.verify) {
+            // 单元从 0 开始覆盖全文件; head_ 之前已在 Open 读入, 只补读其后部分
+            return PrefetchEngine::RunVerified(buf_, *opt.verify, opt, cancel, stats, [this](uint64_t off, uint64_t n) {
+                uint64_t a = std::max(off, head_);
+                return a >= off + n || ReadFully(a, off + n - a);
+            });
+        }
+        return PrefetchEngine::RunChunks(size_ - head_, opt, cancel, stats,
+                                         [this](uint64_t off, uint64_t n) { return ReadFully(head_ + off, n); });
+    }
+
+    bool ReadFully(uint64_t off, uint64_t n) {
+        while (n > 0) {
+            ssize_t r = io_->Pread(fd_, buf_ + off, n, off);
+            if (r < 0 && errno == EINTR) continue;
+            if (r <= 0) {
+                LOG_ERROR << "pread fail: off=" << off << " err=" << (r == 0 ? "eof" : strerror(errno)) << std::endl;
+                return false;
+            }
+            off += r;
+            n -= r;
+        }
+        return true;
+    }
+
+    LoadBackendOptions opt_;
+    const FileAccess* io_ = &FileAccess::Local();
+    int fd_{-1};
+    char* buf_{nullptr};
+    uint64_t size_{0};
+    uint64_t alloc_{0};
+    uint64_t head_{0};
+    HugePageMode huge_mode_{HugePageMode::kOff};
+};
+
+#include <sys/syscall.h>
+#if __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup)
+#include <linux/io_uring.h>
+#include <sys/uio.h>
+#define HAVE_IO_URING 1
+#endif
+
+class IoUringBackend : public PreadBackend {
+public:
+    explicit IoUringBackend(const LoadBackendOptions& opt) : PreadBackend(opt) {}
+    const char* name() const override { return "uring"; }
+
+protected:
+    bool ReadRest(const PrefetchOptions& opt, const std::atomic<bool>* cancel, PrefetchStats* stats) override {
+#ifdef HAVE_IO_URING
+        // 校验需要 "读完即算 hash" 的逐单元回调, 走 pread 的融合路径
+        if (opt.verify) return PreadBackend::ReadRest(opt, cancel, stats);
+        int r = ReadRing(opt, cancel, stats);
+        if (r >= 0) return r == 1;
+        LOG_INFO << "io_uring unavailable (" << strerror(-r) << "), fallback to pread" << std::endl;
+#endif
+        return PreadBackend::ReadRest(opt, cancel, stats);
+    }
+
+private:
+#ifdef HAVE_IO_URING
+    // 1 = 成功, 0 = 读失败/取消, <0 = -errno (ring 不可用, 调用方回退)
+    int ReadRing(const PrefetchOptions& opt, const std::atomic<bool>* cancel, PrefetchStats* stats) {
+        using clock = std::chrono::steady_clock;
+        const uint32_t depth = std::max<uint32_t>(1, opt_.uring_depth);
+        io_uring_params params{};
+        int ring = (int)::syscall(__NR_io_uring_setup, depth, &params);
+        if (ring < 0) return -errno;
+
+        const size_t sq_len = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+        const size_t cq_len = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const size_t sqe_len = params.sq_entries * sizeof(io_uring_sqe);
+        char* sq = static_cast<char*>(::mmap(nullptr, sq_len, PROT_READ | PROT_WRITE,
+                                             MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING));
+        char* cq = static_cast<char*>(::mmap(nullptr, cq_len, PROT_READ | PROT_WRITE,
+                                             MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING));
+        auto* sqes = static_cast<io_uring_sqe*>(::mmap(nullptr, sqe_len, PROT_READ | PROT_WRITE,
+                                                       MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES));
+        auto cleanup = [&] {
+            if (sq != MAP_FAILED) ::munmap(sq, sq_len);
+            if (cq != MAP_FAILED) ::munmap(cq, cq_len);
+            if (sqes != MAP_FAILED) ::munmap(sqes, sqe_len);
+            ::close(ring);
+        };
+        if (sq == MAP_FAILED || cq == MAP_FAILED || sqes == MAP_FAILED) {
+            int err = errno;
+            cleanup();
+            return -err;
+        }
+        auto* sq_tail  = reinterpret_cast<uint32_t*>(sq + params.sq_off.tail);
+        auto* sq_mask  = reinterpret_cast<uint32_t*>(sq + params.sq_off.ring_mask);
+        auto* sq_array = reinterpret_cast<uint32_t*>(sq + params.sq_off.array);
+        auto* cq_head  = reinterpret_cast<uint32_t*>(cq + params.cq_off.head);
+        auto* cq_tail  = reinterpret_cast<uint32_t*>(cq + params.cq_off.tail);
+        auto* cq_mask  = reinterpret_cast<uint32_t*>(cq + params.cq_off.ring_mask);
+        auto* cqes     = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+        const uint32_t slots = std::min(depth, params.sq_entries);
+        const uint64_t block = std::max<uint64_t>(opt_.uring_block & ~4095ull, 4096);
+        const uint64_t total = size_ - head_;
+        std::vector<iovec> iov(slots);
+        std::vector<uint64_t> slot_off(slots);
+        std::vector<uint32_t> free_slots;
+        for (uint32_t i = 0; i < slots; ++i) free_slots.push_back(i);
+
+        uint64_t issued = 0, done = 0;
+        uint32_t inflight = 0;   // 已提交未完成的读; 每个 CQE 都要归还, 否则排空时会空等
+        bool failed = false;
+        auto start = clock::now();
+        auto submit = [&](uint32_t slot, uint64_t off, uint64_t n) {
+            iov[slot].iov_base = buf_ + off;
+            iov[slot].iov_len = n;
+            slot_off[slot] = off;
+            uint32_t tail = __atomic_load_n(sq_tail, __ATOMIC_ACQUIRE);
+            uint32_t idx = tail & *sq_mask;
+            io_uring_sqe& e = sqes[idx];
+            std::memset(&e, 0, sizeof(e));
+            e.opcode = IORING_OP_READV;
+            e.fd = fd_;
+            e.addr = reinterpret_cast<uint64_t>(&iov[slot]);
+            e.len = 1;
+            e.off = off;
+            e.user_data = slot;
+            sq_array[idx] = idx;
+            __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+            ++inflight;
+        };
+
+        while (done < total && !failed) {
+            uint32_t to_submit = 0;
+            while (!free_slots.empty() && issued < total &&
+                   !(cancel && cancel->load(std::memory_order_relaxed))) {
+                PrefetchEngine::Pace(start, issued, opt.bandwidth_bps);
+                uint32_t slot = free_slots.back();
+                free_slots.pop_back();
+                uint64_t n = std::min(block, total - issued);
+                submit(slot, head_ + issued, n);
+                issued += n;
+                ++to_submit;
+            }
+            if (inflight == 0) break;  // 已取消且无在途
+            int r = (int)::syscall(__NR_io_uring_enter, ring, to_submit, 1u, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (r < 0 && errno != EINTR) {
+                LOG_ERROR << "io_uring_enter fail err=" << strerror(errno) << std::endl;
+                failed = true;
+                break;
+            }
+            uint32_t head = *cq_head;
+            while (head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+                const io_uring_cqe& c = cqes[head & *cq_mask];
+                uint32_t slot = (uint32_t)c.user_data;
+                uint64_t want = iov[slot].iov_len;
+                --inflight;
+                if (c.res < 0 && c.res != -EAGAIN && c.res != -EINTR) {
+                    LOG_ERROR << "io_uring read fail: off=" << slot_off[slot] << " err=" << strerror(-c.res) << std::endl;
+                    failed = true;
+                    free_slots.push_back(slot);
+                } else if (c.res == 0) {
+                    LOG_ERROR << "io_uring read eof: off=" << slot_off[slot] << std::endl;
+                    failed = true;
+                    free_slots.push_back(slot);
+                } else {
+                    uint64_t got = c.res > 0 ? (uint64_t)c.res : 0;
+                    done += got;
+                    if (got < want) {
+                        // 短读: 同一 slot 续读剩余部分
+                        submit(slot, slot_off[slot] + got, want - got);
+                        ::syscall(__NR_io_uring_enter, ring, 1u, 0u, 0u, nullptr, 0);
+                    } else {
+                        free_slots.push_back(slot);
+                    }
+                    if (opt.progress) opt.progress(done, total);
+                }
+                ++head;
+            }
+            __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+        }
+        // 失败/取消时等在途 IO 落地再释放 ring (缓冲仍有效); 只在确有在途读时阻塞
+        while (inflight > 0) {
+            if (::syscall(__NR_io_uring_enter, ring, 0u, 1u, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 && errno != EINTR)
+                break;
+            uint32_t head = *cq_head;
+            while (head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+                --inflight;
+                ++head;
+            }
+            __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+        }
+        cleanup();
+        if (stats) {
+            stats->bytes = done;
+            stats->seconds = std::chrono::duration<double>(clock::now() - start).count();
+        }
+        return (!failed && done == total) ? 1 : 0;
+    }
+#endif
+};
+
+// === memfd 共享 (单加载, 多映射) ===
+// 当选的加载进程把版本 pread 进 memfd, 读完后在原地址 MAP_FIXED 换成只读映射并封存
+// (SHRINK/GROW/WRITE/SEAL), 再经 Unix socket 把 fd 交给同节点其他 reader; 它们只读映射同一份
+// shmem 页, N 个进程只占一份内存、只做一次冷加载. 大页设置不适用于 memfd.
+static constexpr int kMemfdSeals = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL;
+
+class MemfdBackend : public PreadBackend {
+public:
+    explicit MemfdBackend(const LoadBackendOptions& opt) : PreadBackend(opt) {}
+    ~MemfdBackend() override {
+        if (mfd_ >= 0) ::close(mfd_);
+    }
+
+    bool Populate(const PrefetchOptions& opt, const std::atomic<bool>* cancel, PrefetchStats* stats) override {
+        if (!ReadRest(opt, cancel, stats)) return false;
+        // 写映射换成同地址只读映射 (页留在 shmem, 不拷贝), 之后才能加 F_SEAL_WRITE.
+        // 可写 fd 上的 PROT_READ 共享映射仍带 VM_MAYWRITE, 所以经 /proc 重开一个只读 fd 来映射
+        int ro = ::open(("/proc/self/fd/" + std::to_string(mfd_)).c_str(), O_RDONLY | O_CLOEXEC);
+        if (ro < 0 || (size_ && ::mmap(buf_, alloc_, PROT_READ, MAP_SHARED | MAP_FIXED, ro, 0) == MAP_FAILED)) {
+            LOG_ERROR << "memfd remap fail err=" << strerror(errno) << std::endl;
+            if (ro >= 0) ::close(ro);
+            return false;
+        }
+        if (::fcntl(mfd_, F_ADD_SEALS, kMemfdSeals) != 0) {
+            LOG_ERROR << "memfd seal fail err=" << strerror(errno) << std::endl;
+            ::close(ro);
+            return false;
+        }
+        // 之后只保留 (也只交出) 只读 fd
+        ::close(mfd_);
+        mfd_ = ro;
+        sealed_ = true;
+        return true;
+    }
+    const char* name() const override { return "memfd"; }
+    int ShareFd() const override { return sealed_ ? mfd_ : -1; }
+
+protected:
+    bool Alloc() override {
+        mfd_ = ::memfd_create("frozen_kv", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        if (mfd_ < 0 || ::ftruncate(mfd_, (off_t)size_) != 0) {
+            LOG_ERROR << "memfd alloc fail: " << size_ << " err=" << strerror(errno) << std::endl;
+            return false;
+        }
+        alloc_ = size_;
+        void* p = size_ ? ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, mfd_, 0) : nullptr;
+        if (p == MAP_FAILED) {
+            LOG_ERROR << "memfd mmap fail: " << size_ << " err=" << strerror(errno) << std::endl;
+            return false;
+        }
+        buf_ = static_cast<char*>(p);
+        return true;
+    }
+
+private:
+    int mfd_{-1};
+    bool sealed_{false};
+};
+
+// 其他进程交来的 memfd: 校验封存后只读映射; 页已在 shmem, 预热只建页表
+class SharedMemfdBackend : public LoadBackend {
+public:
+    SharedMemfdBackend(int fd, bool verified) : fd_(fd), verified_(verified) {}
+    ~SharedMemfdBackend() override {
+        if (base_ && size_) ::munmap(base_, size_);
+        if (fd_ >= 0) ::close(fd_);
+    }
+
+    bool Open(const std::string& path) override {
+        struct stat st{};
+        int seals = ::fcntl(fd_, F_GET_SEALS);
+        if (::fstat(fd_, &st) != 0 || seals < 0 || (seals & kMemfdSeals) != kMemfdSeals) {
+            LOG_ERROR << "shared memfd for " << path << " not sealed (seals=" << seals << ")" << std::endl;
+            return false;
+        }
+        size_ = (uint64_t)st.st_size;
+        void* p = size_ ? ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd_, 0) : nullptr;
+        if (p == MAP_FAILED) {
+            LOG_ERROR << "shared memfd mmap fail: " << path << " err=" << strerror(errno) << std::endl;
+            return false;
+        }
+        base_ = static_cast<char*>(p);
+        return true;
+    }
+    bool Populate(const PrefetchOptions& opt, const std::atomic<bool>* cancel, PrefetchStats* stats) override {
+        return PopulateMissing(base_, size_, opt, cancel, stats, FileAccess::Local());
+    }
+    const char* data() const override { return base_; }
+    uint64_t size() const override { return size_; }
+    const char* name() const override { return "memfd-shared"; }
+    int ShareFd() const override { return fd_; }
+    // 封存只保证不可改; 内容是否可信取决于加载方是否真的校验过
+    bool Verified() const override { return verified_; }
+
+private:
+    int fd_;
+    bool verified_;
+    char* base_{nullptr};
+    uint64_t size_{0};
+};
+
+// === 分段容器 (STRATSEG) ===
+// 逻辑表按页对齐的段拼成, 段可来自本文件或旧版本文件 (delta 版本只写变化段):
+//   SegFileHeader | SegFileRef[file_cnt] | SegmentRef[seg_cnt] | 数据区 (段按 4 KiB 对齐)
+// file_idx 0 为容器自身, 其余按文件名相对容器目录解析 (可以是普通 STRATEGY 文件).
+// reader 预留一段 PROT_NONE 地址, 逐段 MAP_FIXED 映射到各文件; 与正在服务版本共享的
+// 段在 page cache 中已常驻, 增量预热只会拉取变化的段.
+struct SegFileHeader {
+    char     magic[8];        // "STRATSEG"
+    uint32_t version;         // 1
+    uint32_t file_cnt;
+    uint64_t seg_cnt;
+    uint64_t logical_size;
+    uint64_t data_off;        // 本文件数据区起点
+};
+struct SegFileRef { char name[240]; uint64_t size; uint64_t reserved; };
+struct SegmentRef {
+    uint64_t logical_off;
+    uint64_t len;
+    uint64_t file_off;
+    uint32_t file_idx;
+    uint32_t reserved;
+    uint64_t hash;            // XXH64(段内容)
+};
+static constexpr uint64_t kSegAlign = 4096;
+static constexpr uint32_t kSegMaxFiles = 4096;
+
+struct SegmentTable {
+    uint64_t logical_size = 0;
+    std::vector<std::string> files;   // 绝对/可直接 open 的路径, [0] = 容器自身
+    std::vector<SegmentRef> segs;
+};
+
+static std::string DirOf(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    return slash == std::string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+}
+
+static bool IsSegmentedFile(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    char magic[8] = {0};
+    bool ok = PreadAll(fd, magic, sizeof(magic), 0) && std::memcmp(magic, "STRATSEG", 8) == 0;
+    ::close(fd);
+    return ok;
+}
+
+// 只读元数据 (几 KiB), 不触碰数据区
+static bool ReadSegmentTable(const std::string& path, SegmentTable* out) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    const FileAccess& io = FileAccess::For(path);
+    SegFileHeader h{};
+    bool ok = PreadAll(fd, &h, sizeof(h), 0, io) && std::memcmp(h.magic, "STRATSEG", 8) == 0 && h.version == 1 &&
+              h.file_cnt >= 1 && h.file_cnt <= kSegMaxFiles && h.seg_cnt <= (h.logical_size / kSegAlign + 1);
+    std::vector<SegFileRef> refs;
+    if (ok) {
+        refs.resize(h.file_cnt);
+        out->segs.resize(h.seg_cnt);
+        ok = PreadAll(fd, refs.data(), refs.size() * sizeof(SegFileRef), sizeof(h), io) &&
+             PreadAll(fd, out->segs.data(), out->segs.size() * sizeof(SegmentRef),
+                      sizeof(h) + refs.size() * sizeof(SegFileRef), io);
+    }
+    ::close(fd);
+    if (!ok) {
+        LOG_ERROR << "bad segment table: " << path << std::endl;
+        return false;
+    }
+    out->logical_size = h.logical_size;
+    out->files.clear();
+    out->files.push_back(path);
+    for (uint32_t i = 1; i < h.file_cnt; ++i) {
+        refs[i].name[sizeof(refs[i].name) - 1] = 0;
+        out->files.push_back(DirOf(path) + "/" + refs[i].name);
+    }
+    uint64_t expect = 0;
+    for (const auto& s : out->segs) {
+        if (s.logical_off != expect || s.file_idx >= h.file_cnt || s.logical_off % kSegAlign || s.file_off % kSegAlign) {
+            LOG_ERROR << "bad segment layout: " << path << " logical_off=" << s.logical_off << std::endl;
+            return false;
+        }
+        expect += s.len;
+    }
+    if (expect != h.logical_size) {
+        LOG_ERROR << "segment table covers " << expect << " of " << h.logical_size << ": " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+class SegmentedMmapBackend : public LoadBackend {
+public:
+    ~SegmentedMmapBackend() override {
+        if (base_) ::munmap(base_, reserve_);
+        for (int fd : fds_) if (fd >= 0) ::close(fd);
+    }
+
+    bool Open(const std::string& path) override {
+        io_ = &FileAccess::For(path);
+        if (!ReadSegmentTable(path, &table_)) return false;
+        for (const auto& f : table_.files) {
+            int fd = ::open(f.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                LOG_ERROR << "open segment file fail: " << f << " err=" << strerror(errno) << std::endl;
+                return false;
+            }
+            fds_.push_back(fd);
+        }
+        std::vector<uint64_t> fsize(fds_.size());
+        for (size_t i = 0; i < fds_.size(); ++i) {
+            struct stat st{};
+            fsize[i] = ::fstat(fds_[i], &st) == 0 ? (uint64_t)st.st_size : 0;
+        }
+        reserve_ = std::max<uint64_t>(kSegAlign, (table_.logical_size + kSegAlign - 1) / kSegAlign * kSegAlign);
+        void* p = ::mmap(nullptr, reserve_, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (p == MAP_FAILED) {
+            LOG_ERROR << "reserve fail: " << reserve_ << " err=" << strerror(errno) << std::endl;
+            return false;
+        }
+        base_ = static_cast<char*>(p);
+        for (const auto& s : table_.segs) {
+            if (s.len == 0) continue;
+            if (s.file_off + s.len > fsize[s.file_idx]) {
+                LOG_ERROR << "segment beyond file end: " << table_.files[s.file_idx] << " off=" << s.file_off << std::endl;
+                return false;
+            }
+            if (::mmap(base_ + s.logical_off, s.len, PROT_READ, MAP_SHARED | MAP_FIXED,
+                       fds_[s.file_idx], (off_t)s.file_off) == MAP_FAILED) {
+                LOG_ERROR << "segment map fail: " << table_.files[s.file_idx] << " err=" << strerror(errno) << std::endl;
+                return false;
+            }
+        }
+        LOG_INFO << "[segmap] " << path << " segments=" << table_.segs.size()
+                 << " files=" << table_.files.size() << " logical=" << table_.logical_size << std::endl;
+        return true;
+    }
+    bool Populate(const PrefetchOptions& opt, const std::atomic<bool>* cancel, PrefetchStats* stats) override {
+        if (opt.verify) return PrefetchEngine::RunVerified(data(), *opt.verify, opt, cancel, stats, *io_);
+        return PopulateMissing(data(), size(), opt, cancel, stats, *io_);
+    }
+    const char* data() const override { return base_; }
+    uint64_t size() const override { return table_.logical_size; }
+    const char* name() const override { return "segmap"; }
+    const FileAccess& Access() const override { return *io_; }
+    const SegmentTable& Table() const { return table_; }
+    bool SegmentSums(std::vector<VerifyUnit>* out) const override {
+        out->clear();
+        for (const auto& s : table_.segs)
+            if (s.len) out->push_back(VerifyUnit{s.logical_off, s.len, s.hash});
+        return true;
+    }
+
+    bool Evictable() const override { return true; }
+    // 同 MmapBackend; page cache 按段所在文件的区间丢弃
+    void Evict(uint64_t off, uint64_t len, bool hard) const override {
+        off &= ~(kSegAlign - 1);
+        if (off >= size() || len == 0) return;
+        len = std::min(len, size() - off);
+        if (!hard) {
+            ::madvise(base_ + off, len, MADV_COLD);
+            return;
+        }
+        ::madvise(base_ + off, len, MADV_PAGEOUT);
+        ::madvise(base_ + off, len, MADV_DONTNEED);
+        for (const auto& s : table_.segs) {
+            uint64_t a = std::max(off, s.logical_off), b = std::min(off + len, s.logical_off + s.len);
+            if (a < b)
+                ::posix_fadvise(fds_[s.file_idx], (off_t)(s.file_off + a - s.logical_off), (off_t)(b - a),
+                                POSIX_FADV_DONTNEED);
+        }
+    }
+
+private:
+    SegmentTable table_;
+    std::vector<int> fds_;
+    char* base_{nullptr};
+    uint64_t reserve_{0};
+    const FileAccess* io_ = &FileAccess::Local();
+};
+
+static std::unique_ptr<LoadBackend> MakeLoadBackend(const LoadBackendOptions& opt, const std::string& path) {
+    if (opt.shared_fd >= 0) return std::make_unique<SharedMemfdBackend>(opt.shared_fd, opt.shared_verified);
+    if (IsSegmentedFile(path)) {
+        // 分段容器靠跨版本共享 page cache 省流量, 只走文件映射
+        if (opt.kind != "mmap" || opt.huge_pages != HugePageMode::kOff)
+            LOG_INFO << "segmented container " << path << ", LOAD_BACKEND/LOAD_HUGEPAGES ignored" << std::endl;
+        return std::make_unique<SegmentedMmapBackend>();
+    }
+    if (opt.kind == "pread") return std::make_unique<PreadBackend>(opt);
+    if (opt.kind == "uring") {
+        // io_uring 读 FUSE 文件由 io-wq 线程阻塞执行, 等价于并行 pread; 模拟存储同样按 pread 计费
+        if (!FileAccess::For(path).Simulated()) return std::make_unique<IoUringBackend>(opt);
+        LOG_INFO << "simulated storage " << path << ", uring loads via pread" << std::endl;
+        return std::make_unique<PreadBackend>(opt);
+    }
+    if (opt.kind == "memfd") return std::make_unique<MemfdBackend>(opt);
+    if (opt.huge_pages != HugePageMode::kOff) {
+        // page cache 不提供 2 MiB 映射, 大页模式把文件读入匿名大页缓冲
+        LOG_INFO << "LOAD_HUGEPAGES set, load via pread into huge-page buffer" << std::endl;
+        return std::make_unique<PreadBackend>(opt);
+    }
+    if (opt.kind != "mmap") LOG_ERROR << "unknown LOAD_BACKEND " << opt.kind << ", use mmap" << std::endl;
+    return std::make_unique<MmapBackend>();
+}
+
+// === 分块校验尾 (STRATSUM) ===
+// 普通表文件 (非 STRATSEG) 末尾追加: uint64_t hash[chunk_cnt] | SumFooter, covered 为校验尾起点,
+// hash[i] = XXH64([i * chunk_bytes, min(covered, (i + 1) * chunk_bytes))). self_hash 覆盖 hash 数组与
+// footer 前三个字段. header 推出的布局不含文件尾, 旧 reader 忽略这些字节.
+struct SumFooter {
+    uint64_t chunk_bytes;
+    uint64_t chunk_cnt;
+    uint64_t covered;
+    uint64_t self_hash;
+    char     magic[8];        // "STRATSUM"
+};
+static constexpr uint64_t kSumChunk = 8ull << 20;
+
+static uint64_t SumChunks(uint64_t covered, uint64_t chunk) { return (covered + chunk - 1) / chunk; }
+static uint64_t SumTrailerBytes(uint64_t covered, uint64_t chunk) {
+    return chunk ? SumChunks(covered, chunk) * sizeof(uint64_t) + sizeof(SumFooter) : 0;
+}
+
+static std::string EncodeSumTrailer(const std::vector<uint64_t>& hashes, uint64_t covered, uint64_t chunk) {
+    const uint64_t arr = hashes.size() * sizeof(uint64_t);
+    SumFooter f{};
+    f.chunk_bytes = chunk;
+    f.chunk_cnt = hashes.size();
+    f.covered = covered;
+    std::memcpy(f.magic, "STRATSUM", 8);
+    std::string out(arr + sizeof(f), '\0');
+    std::memcpy(&out[0], hashes.data(), arr);
+    std::memcpy(&out[arr], &f, sizeof(f));
+    f.self_hash = Xxh64::Hash(out.data(), arr + offsetof(SumFooter, self_hash));
+    std::memcpy(&out[arr], &f, sizeof(f));
+    return out;
+}
+
+// 数据已在内存 (builder 输出映射): 各块 hash 并行计算
+static std::string BuildSumTrailer(const char* data, uint64_t covered, uint64_t chunk, uint32_t threads) {
+    std::vector<uint64_t> hashes(SumChunks(covered, chunk));
+    const uint32_t n = (uint32_t)std::max<uint64_t>(1, std::min<uint64_t>(threads, hashes.size()));
+    ParallelFor(n, [&](uint32_t t) {
+        for (uint64_t i = t; i < hashes.size(); i += n)
+            hashes[i] = Xxh64::Hash(data + i * chunk, std::min(chunk, covered - i * chunk));
+    });
+    return EncodeSumTrailer(hashes, covered, chunk);
+}
+
+// 流式写出: 数据按偏移顺序经过 Fill, 顺带累计块 hash, 越过 covered 后输出校验尾
+class SumTrailerWriter {
+public:
+    SumTrailerWriter(uint64_t covered, uint64_t chunk) : covered_(covered), chunk_(chunk) {}
+    uint64_t FileSize() const { return covered_ + SumTrailerBytes(covered_, chunk_); }
+
+    template <typename Fn>
+    void Fill(Fn&& inner, uint64_t off, char* buf, std::size_t n) {
+        const uint64_t data_n = off < covered_ ? std::min<uint64_t>(n, covered_ - off) : 0;
+        if (data_n) {
+            inner(off, buf, data_n);
+            Update(buf, data_n);
+        }
+        if (data_n == n) return;
+        if (trailer_.empty()) {
+            if (fill_) hashes_.push_back(cur_.Digest());
+            trailer_ = EncodeSumTrailer(hashes_, covered_, chunk_);
+        }
+        std::memcpy(buf + data_n, trailer_.data() + (off + data_n - covered_), n - data_n);
+    }
+
+private:
+    void Update(const char* p, uint64_t n) {
+        while (n) {
+            const uint64_t take = std::min(n, chunk_ - fill_);
+            cur_.Update(p, take);
+            fill_ += take;
+            p += take;
+            n -= take;
+            if (fill_ == chunk_) {
+                hashes_.push_back(cur_.Digest());
+                cur_.Reset();
+                fill_ = 0;
+            }
+        }
+    }
+
+    uint64_t covered_;
+    uint64_t chunk_;
+    uint64_t fill_ = 0;
+    Xxh64 cur_;
+    std::vector<uint64_t> hashes_;
+    std::string trailer_;
+};
+
+enum class SumState { kNone, kOk, kCorrupt };
+
+// reader: 取出校验单元. STRATSEG 用段表; 普通文件解析校验尾, 最后一个单元顺带读入校验尾.
+// 没有校验尾 (旧文件) 返回 kNone; magic 在但不自洽返回 kCorrupt.
+static SumState LoadVerifyUnits(const LoadBackend& be, std::vector<VerifyUnit>* out, const char** source) {
+    out->clear();
+    if (be.SegmentSums(out)) {
+        *source = "segments";
+        return SumState::kOk;
+    }
+    *source = "trailer";
+    const uint64_t size = be.size();
+    SumFooter f{};
+    if (size < sizeof(f) || !be.Peek(size - sizeof(f), &f, sizeof(f)) || std::memcmp(f.magic, "STRATSUM", 8) != 0)
+        return SumState::kNone;
+    if (f.chunk_bytes == 0 || f.chunk_bytes % 4096 || f.covered > size ||
+        f.chunk_cnt != SumChunks(f.covered, f.chunk_bytes) || SumTrailerBytes(f.covered, f.chunk_bytes) != size - f.covered) {
+        LOG_ERROR << "[verify] bad checksum trailer: chunk=" << f.chunk_bytes << " chunks=" << f.chunk_cnt
+                  << " covered=" << f.covered << " size=" << size << std::endl;
+        return SumState::kCorrupt;
+    }
+    std::vector<uint64_t> hashes(f.chunk_cnt);
+    std::string raw(size - f.covered, '\0');
+    if (!be.Peek(f.covered, &raw[0], raw.size()) ||
+        Xxh64::Hash(raw.data(), f.chunk_cnt * sizeof(uint64_t) + offsetof(SumFooter, self_hash)) != f.self_hash) {
+        LOG_ERROR << "[verify] checksum trailer self-check failed" << std::endl;
+        return SumState::kCorrupt;
+    }
+    std::memcpy(hashes.data(), raw.data(), hashes.size() * sizeof(uint64_t));
+    for (uint64_t i = 0; i < f.chunk_cnt; ++i) {
+        const uint64_t off = i * f.chunk_bytes;
+        out->push_back(VerifyUnit{off, std::min(f.chunk_bytes, f.covered - off), hashes[i]});
+    }
+    if (!out->empty()) out->back().extra = raw.size();
+    return SumState::kOk;
+}
+
+// === 冻结文件结构 ===
+struct FrozenHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t model_cnt;
+    uint32_t bucket_cnt;
+    uint32_t entry_cnt;
+    uint32_t val_pool_sz;
+};
+using Header = FrozenHeader;  // 兼容引用代码
+struct Model { uint32_t model_id; uint32_t version; };
+struct Entry { uint32_t key_hash; uint32_t value_offset; uint32_t value_size; };
+
+// v2: 计数/偏移全部 64 位, 突破 v1 的 4 GiB value pool 上限; 与 v1 共用 magic, 以 version 区分.
+// key_hash 存完整 HashKey64, 桶起始下标为 uint64_t.
+struct FrozenHeaderV2 {
+    char     magic[8];
+    uint32_t version;      // 2
+    uint32_t model_cnt;
+    uint64_t bucket_cnt;
+    uint64_t entry_cnt;
+    uint64_t val_pool_sz;
+};
+struct EntryV2 { uint64_t key_hash; uint64_t value_offset; uint64_t value_size; };
+
+// 两种格式的类型表, reader 探测与 builder 写出共用
+struct LayoutV1 {
+    using Hdr = FrozenHeader;
+    using Bucket = uint32_t;
+    using Ent = Entry;
+    static constexpr uint32_t kVersion = 1;
+    static uint32_t Tag(uint64_t h) { return static_cast<uint32_t>(h); }
+};
+struct LayoutV2 {
+    using Hdr = FrozenHeaderV2;
+    using Bucket = uint64_t;
+    using Ent = EntryV2;
+    static constexpr uint32_t kVersion = 2;
+    static uint64_t Tag(uint64_t h) { return h; }
+};
+
+// v3 (swiss): 开放寻址, 每组 16 个控制字节 (空槽 kCtrlEmpty, 占用槽为 hash 高 7 位),
+// 一次 SIMD 比较筛出组内候选; 槽位存完整 64 位 hash 与 key, 命中需 key 逐字节相等.
+// 布局: header | models | ctrl[group_cnt * 16 + 16] | slots[group_cnt * 16] | kv_pool (key 后紧跟 value),
+// ctrl / slots 起点按 cache line 对齐. ctrl 末尾 16 字节复制第 0 组, 供只有一组时 AVX2 整读 32 字节.
+struct FrozenHeaderV3 {
+    char     magic[8];
+    uint32_t version;      // 3
+    uint32_t model_cnt;
+    uint64_t group_cnt;    // 2 的幂
+    uint64_t entry_cnt;
+    uint64_t val_pool_sz;  // kv_pool 字节数
+};
+struct SlotV3 { uint64_t key_hash; uint64_t kv_offset; uint32_t key_size; uint32_t value_size; };
+static constexpr uint32_t kSwissGroup = 16;
+static constexpr uint8_t kCtrlEmpty = 0x80;
+static inline uint8_t SwissH2(uint64_t h) { return static_cast<uint8_t>(h >> 57); }
+
+struct SwissLayout { uint64_t ctrl, slots, kv, end; };
+static SwissLayout SwissLayoutOf(uint32_t model_cnt, uint64_t group_cnt, uint64_t kv_sz) {
+    auto line = [](uint64_t v) { return (v + 63) & ~63ull; };
+    SwissLayout l;
+    l.ctrl = line(sizeof(FrozenHeaderV3) + uint64_t(model_cnt) * sizeof(Model));
+    l.slots = line(l.ctrl + group_cnt * kSwissGroup + kSwissGroup);
+    l.kv = l.slots + group_cnt * kSwissGroup * sizeof(SlotV3);
+    l.end = l.kv + kv_sz;
+    return l;
+}
+
+// === Key hash ===
+// FNV-1a 64 + fmix64 收尾, 低位分布足够均匀, 可直接 & mask_ 取桶.
+// bucket_[b] 为桶 b 在 entries_ 中的起始下标, 桶 b 的 Entry 连续存放到 bucket_[b+1] (末桶到 entry_cnt).
+static inline uint64_t HashKey64(std::string_view key) {
+    uint64_t h = 1469598103934665603ULL;
+    for (unsigned char c : key) {
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+static inline uint32_t HashKey(std::string_view key) {
+    return static_cast<uint32_t>(HashKey64(key));
+}
+
+// 段布局, 由 header 推出 (reader 与 writer 共用)
+template <typename L>
+static std::vector<TableSection> LayoutSectionsT(const typename L::Hdr& h) {
+    uint64_t models = sizeof(typename L::Hdr) + uint64_t(h.model_cnt) * sizeof(Model);
+    uint64_t buckets = uint64_t(h.bucket_cnt) * sizeof(typename L::Bucket);
+    uint64_t entries = uint64_t(h.entry_cnt) * sizeof(typename L::Ent);
+    return {TableSection{"models", 0, models},
+            TableSection{"buckets", models, buckets},
+            TableSection{"entries", models + buckets, entries},
+            TableSection{"value_pool", models + buckets + entries, h.val_pool_sz}};
+}
+static std::vector<TableSection> LayoutSections(const FrozenHeader& h) { return LayoutSectionsT<LayoutV1>(h); }
+static std::vector<TableSection> LayoutSections(const FrozenHeaderV2& h) { return LayoutSectionsT<LayoutV2>(h); }
+static std::vector<TableSection> LayoutSections(const FrozenHeaderV3& h) {
+    const SwissLayout l = SwissLayoutOf(h.model_cnt, h.group_cnt, h.val_pool_sz);
+    return {TableSection{"models", 0, l.ctrl},
+            TableSection{"ctrl", l.ctrl, l.slots - l.ctrl},
+            TableSection{"slots", l.slots, l.kv - l.slots},
+            TableSection{"value_pool", l.kv, h.val_pool_sz}};
+}
+
+// === Swiss 组探测 ===
+// Match 返回 kGroups * 16 位掩码: match 为控制字节 == h2 的槽, empty 为空槽.
+// AVX2 一次比较对齐的一对组 (32 字节不跨 cache line). 运行时按 CPU 特性选择, LOOKUP_SIMD=scalar|sse2|avx2 指定.
+enum class SwissProbe { kScalar, kSse2, kAvx2 };
+
+struct ProbeScalar {
+    static constexpr uint32_t kGroups = 1;
+    static void Match(const uint8_t* ctrl, uint8_t h2, uint32_t* match, uint32_t* empty) {
+        uint32_t m = 0, e = 0;
+        for (uint32_t i = 0; i < kSwissGroup; ++i) {
+            m |= uint32_t(ctrl[i] == h2) << i;
+            e |= uint32_t(ctrl[i] == kCtrlEmpty) << i;
+        }
+        *match = m, *empty = e;
+    }
+};
+#if defined(__x86_64__) || defined(__i386__)
+struct ProbeSse2 {
+    static constexpr uint32_t kGroups = 1;
+    static void Match(const uint8_t* ctrl, uint8_t h2, uint32_t* match, uint32_t* empty) {
+        __m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+        *match = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8((char)h2)));
+        *empty = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8((char)kCtrlEmpty)));
+    }
+};
+struct ProbeAvx2 {
+    static constexpr uint32_t kGroups = 2;
+    __attribute__((target("avx2")))
+    static void Match(const uint8_t* ctrl, uint8_t h2, uint32_t* match, uint32_t* empty) {
+        __m256i g = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ctrl));
+        *match = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(g, _mm256_set1_epi8((char)h2)));
+        *empty = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(g, _mm256_set1_epi8((char)kCtrlEmpty)));
+    }
+};
+#endif
+
+static SwissProbe DetectSwissProbe() {
+#if defined(__x86_64__) || defined(__i386__)
+    const char* env = std::getenv("LOOKUP_SIMD");
+    const std::string want = env ? env : "auto";
+    __builtin_cpu_init();
+    const bool avx2 = __builtin_cpu_supports("avx2");
+    const bool sse2 = __builtin_cpu_supports("sse2");
+    // auto 取 SSE2: 装载率 <= 7/8 时绝大多数探测在 home 组内结束, 一次 16 字节比较正好一组,
+    // AVX2 的组对比较在这里实测不占优, 只在显式 LOOKUP_SIMD=avx2 且 CPU 支持时启用.
+    if (want == "scalar") return SwissProbe::kScalar;
+    if (want == "avx2" && avx2) return SwissProbe::kAvx2;
+    return sse2 ? SwissProbe::kSse2 : SwissProbe::kScalar;
+#else
+    return SwissProbe::kScalar;
+#endif
+}
+static const char* SwissProbeName(SwissProbe p) {
+    return p == SwissProbe::kAvx2 ? "avx2" : p == SwissProbe::kSse2 ? "sse2" : "scalar";
+}
+
+// === Manifest ===
+// v1: 单行目标路径 (兼容旧 writer).
+// v2: key=value 行, 由 writer 原子发布; generation 单调递增, reader 据此判断
+// reload / skip, 并用 size / sections 在不读目标文件内容的情况下交叉校验.
+struct ManifestInfo {
+    int version = 1;
+    std::string target;
+    uint64_t generation = 0;
+    uint64_t size = 0;
+    uint64_t checksum = 0;          // XXH64 整个文件
+    bool has_checksum = false;
+    std::vector<std::pair<std::string, ByteRange>> sections;
+    uint64_t published_at_ns = 0;
+};
+
+// === Loader ===
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-variable"
+#endif
+
+// 移除 MMapFile，直接使用 boost::interprocess
+class FrozenHashMapImpl {
+public:
+    bool Build(const std::string& file) {
+        auto begin = std::chrono::system_clock::now();
+        if (!Map(file) || !Validate()) return false;
+        Warm(PrefetchOptions{}, nullptr);
+
+        double cost = std::chrono::duration<double>(
+            std::chrono::system_clock::now() - begin).count();
+        SPD_LOG_INFO(" {} success", ModelsDesc());
+        SPD_LOG_INFO(" kv file: {}, entry count: {}, bucket count: {}, value pool size: {}, successfully !, cost: {:.2f}s",
+                     file, size_, bucket_cnt_, val_pool_sz_, cost);
+        return true;
+    }
+
+    // --- 分阶段加载: Map -> Validate -> Warm, 供后台 StagedLoader 逐段推进 ---
+    bool Map(const std::string& file, const LoadBackendOptions& backend = LoadBackendOptions{}) {
+        file_path_ = file;
+        source_ = MakeLoadBackend(backend, file);
+        if (!source_->Open(file)) return false;
+        base_ = source_->data();
+        map_size_ = source_->size();
+        return true;
+    }
+
+    bool Validate() {
+        const std::string& file = file_path_;
+        if (map_size_ < sizeof(Header)) {
+            LOG_ERROR << "file too small: " << file << std::endl;
+            return false;
+        }
+        const Header* h = reinterpret_cast<const Header*>(base_);
+        if (std::strncmp(h->magic, "STRATEGY", 8) != 0 || h->version == 0 || h->version > 3) {
+            LOG_ERROR << "bad header in file: " << file
+                      << ", magic: " << std::string(h->magic, 8)
+                      << ", version: " << h->version << std::endl;
+            return false;
+        }
+        if (h->version == 3) return ValidateSwiss();
+        return h->version == 1 ? ValidateT<LayoutV1>() : ValidateT<LayoutV2>();
+    }
+
+    // 由后端把整张表变为常驻 (mmap 缺页预热 / pread, io_uring 读入)
+    bool Warm(const PrefetchOptions& opt, const std::atomic<bool>* cancel, PrefetchStats* stats = nullptr) {
+        if (!source_) return true;
+        return source_->Populate(opt, cancel, stats);
+    }
+
+    // 段划分 (header 计入 models)
+    std::vector<TableSection> Sections() const {
+        if (hdr3_) return LayoutSections(*hdr3_);
+        if (hdr2_) return LayoutSections(*hdr2_);
+        return hdr_ ? LayoutSections(*hdr_) : std::vector<TableSection>{};
+    }
+
+    // 各段常驻情况, 最后一项为整个映射 ("total")
+    std::vector<SectionResidency> SectionResidencies() const {
+        std::vector<SectionResidency> out;
+        ResidencyTracker tracker;
+        if (!base_ || !tracker.Scan(base_, map_size_)) return out;
+        for (const auto& sec : Sections()) out.push_back(tracker.Section(sec));
+        out.push_back(tracker.Total());
+        return out;
+    }
+
+    // 整个映射的常驻比例 [0, 1]
+    double Residency() const {
+        ResidencyTracker tracker;
+        if (!base_ || !tracker.Scan(base_, map_size_)) return 0.0;
+        return tracker.Total().Ratio();
+    }
+
+    // 给定区间的常驻比例
+    double Residency(const std::vector<ByteRange>& ranges) const {
+        ResidencyTracker tracker;
+        if (!base_ || !tracker.Scan(base_, map_size_)) return 0.0;
+        uint64_t pages = 0, resident = 0;
+        for (const auto& r : ranges) {
+            auto sr = tracker.Section(TableSection{"", r.first, r.second});
+            pages += sr.pages;
+            resident += sr.resident;
+        }
+        return pages ? double(resident) / pages : 0.0;
+    }
+
+    // --- 内存预算 ---
+    // 预算内的预热计划: models/buckets/entries 常驻, value_pool 取前缀填满剩余预算
+    std::vector<ByteRange> BudgetPlan(uint64_t budget) const {
+        std::vector<ByteRange> plan;
+        uint64_t pool_off = uint64_t(val_pool_ - base_);
+        plan.emplace_back(0, pool_off);
+        uint64_t left = budget > pool_off ? budget - pool_off : 0;
+        uint64_t take = std::min<uint64_t>(left, val_pool_sz_) & ~4095ull;
+        if (take) plan.emplace_back(pool_off, take);
+        return plan;
+    }
+
+    // opt.verify 非空时改按校验单元预热 (单元由调用方按 ranges 筛好, 仅文件映射后端)
+    bool WarmRanges(const std::vector<ByteRange>& ranges, const PrefetchOptions& opt,
+                    const std::atomic<bool>* cancel, PrefetchStats* stats = nullptr) const {
+        const FileAccess& io = source_ ? source_->Access() : FileAccess::Local();
+        if (opt.verify) return PrefetchEngine::RunVerified(base_, *opt.verify, opt, cancel, stats, io);
+        return PrefetchEngine::RunRanges(base_, ranges, opt, cancel, stats, io);
+    }
+
+    // 分块校验和 (段表 / 校验尾), 供预热时融合校验
+    SumState ChecksumUnits(std::vector<VerifyUnit>* out, const char** source) const {
+        return source_ ? LoadVerifyUnits(*source_, out, source) : SumState::kNone;
+    }
+
+    // value_pool 按 kHeatRange 分区的查询热度, 每 kHeatSample 次查询采样一次
+    static constexpr uint32_t kHeatShift = 21;             // 2 MiB
+    static constexpr uint64_t kHeatRange = 1ull << kHeatShift;
+    static constexpr uint32_t kHeatSample = 64;
+    void EnableHeatSampling() {
+        if (!version_) return;
+        heat_n_ = (val_pool_sz_ + kHeatRange - 1) >> kHeatShift;
+        heat_.reset(new std::atomic<uint32_t>[heat_n_ + 1]());
+    }
+    // 取出并清零各分区的采样计数
+    std::vector<uint32_t> DrainHeat() const {
+        std::vector<uint32_t> v(heat_ ? heat_n_ : 0);
+        for (size_t i = 0; i < v.size(); ++i) v[i] = heat_[i].exchange(0, std::memory_order_relaxed);
+        return v;
+    }
+    uint64_t ValuePoolOffset() const { return uint64_t(val_pool_ - base_); }
+    uint64_t ValuePoolSize() const { return val_pool_sz_; }
+
+    std::string ModelsDesc() const {
+        std::stringstream ss;
+        ss << "load model:";
+        for (uint32_t i = 0; i < model_cnt_; ++i)
+            ss << " <" << models_[i].model_id << ":" << models_[i].version << ">";
+        return ss.str();
+    }
+    uint64_t MappedSize() const { return map_size_; }
+    const char* BackendName() const { return source_ ? source_->name() : "none"; }
+    const LoadBackend* Backend() const { return source_.get(); }
+
+    // 与 v2 manifest 声明的 size / sections 交叉校验 (只看 header, 不读内容)
+    bool MatchesManifest(const ManifestInfo& m, std::string* why) const {
+        if (m.size && m.size != map_size_) {
+            *why = "size " + std::to_string(map_size_) + " != manifest " + std::to_string(m.size);
+            return false;
+        }
+        auto secs = Sections();
+        for (const auto& want : m.sections) {
+            auto it = std::find_if(secs.begin(), secs.end(),
+                                   [&](const TableSection& t) { return want.first == t.name; });
+            if (it == secs.end() || it->offset != want.second.first || it->len != want.second.second) {
+                *why = "section " + want.first + " mismatch";
+                return false;
+            }
+        }
+        return true;
+    }
+    uint64_t ContentHash() const { return base_ ? Xxh64::Hash(base_, map_size_) : 0; }
+
+    // 按 hash 查找, 返回 mapping 内的 Entry; 未命中返回 nullptr. v1 用 32 位 hash, v2 用 Find64.
+    const Entry* Find(uint32_t hash) const {
+        return version_ == 1 ? FindT<LayoutV1>(hash) : nullptr;
+    }
+    const EntryV2* Find64(uint64_t hash) const {
+        return version_ == 2 ? FindT<LayoutV2>(hash) : nullptr;
+    }
+
+    // v3: 按 key 查槽 (hash + key 双重校验), 未命中返回 nullptr
+    const SlotV3* FindSwiss(uint64_t hash, std::string_view key) const {
+        if (version_ != 3) return nullptr;
+        switch (probe_) {
+#if defined(__x86_64__) || defined(__i386__)
+        case SwissProbe::kAvx2: return FindSwissAvx2(hash, key);
+        case SwissProbe::kSse2: return FindSwissT<ProbeSse2>(hash, key);
+#endif
+        default: return FindSwissT<ProbeScalar>(hash, key);
+        }
+    }
+
+    // 零拷贝点查: value 直接指向 val_pool_, 生命周期同当前 mapping.
+    bool Get(std::string_view key, std::string_view* value) const {
+        if (version_ == 3) {
+            const SlotV3* s = FindSwiss(HashKey64(key), key);
+            if (!s) return false;
+            SampleHeat(s->kv_offset);
+            *value = std::string_view(val_pool_ + s->kv_offset + s->key_size, s->value_size);
+            return true;
+        }
+        return version_ == 2 ? GetT<LayoutV2>(key, value) : GetT<LayoutV1>(key, value);
+    }
+
+    // 批量查询: 每组 kMultiGetGroup 个 key 分阶段推进 (bucket -> entry -> value),
+    // 每阶段先对整组发 prefetch, 让多个 key 的 cache/TLB miss 重叠.
+    // out[i] 命中时指向 val_pool_, 未命中为空 view (data() == nullptr). 返回命中数.
+    size_t MultiGet(const std::string_view* keys, size_t n, std::string_view* out) const {
+        if (version_ == 3) {
+            switch (probe_) {
+#if defined(__x86_64__) || defined(__i386__)
+            case SwissProbe::kAvx2: return MultiGetSwissAvx2(keys, n, out);
+            case SwissProbe::kSse2: return MultiGetSwissT<ProbeSse2>(keys, n, out);
+#endif
+            default: return MultiGetSwissT<ProbeScalar>(keys, n, out);
+            }
+        }
+        return version_ == 2 ? MultiGetT<LayoutV2>(keys, n, out) : MultiGetT<LayoutV1>(keys, n, out);
+    }
+
+    uint64_t Size() const { return size_; }
+    uint32_t Version() const { return version_; }
+    // v3 查询实际使用的组探测实现
+    const char* ProbeName() const { return version_ == 3 ? SwissProbeName(probe_) : "csr"; }
+    const std::string& FilePath() const { return file_path_; }
+
+private:
+    template <typename L>
+    bool ValidateT() {
+        const std::string& file = file_path_;
+        const auto* h = reinterpret_cast<const typename L::Hdr*>(base_);
+        if (map_size_ < sizeof(*h)) {
+            LOG_ERROR << "file too small: " << file << std::endl;
+            return false;
+        }
+        // 逐项检查乘法/加法溢出, 避免损坏的 64 位计数绕过边界判断
+        const uint64_t fsz = map_size_;
+        uint64_t need = sizeof(*h);
+        auto add = [&](uint64_t cnt, uint64_t unit) {
+            if (unit && cnt > (fsz - std::min(need, fsz)) / unit) return false;
+            need += cnt * unit;
+            return need <= fsz;
+        };
+        if (!add(h->model_cnt, sizeof(Model)) || !add(h->bucket_cnt, sizeof(typename L::Bucket)) ||
+            !add(h->entry_cnt, sizeof(typename L::Ent)) || !add(h->val_pool_sz, 1) ||
+            (h->bucket_cnt & (h->bucket_cnt - 1)) != 0) {
+            LOG_ERROR << "bad layout in file: " << file
+                      << ", need: " << need << ", size: " << fsz
+                      << ", bucket count: " << h->bucket_cnt << std::endl;
+            return false;
+        }
+
+        models_ = reinterpret_cast<const Model*>(base_ + sizeof(*h));
+        for (uint32_t i = 0; i < h->model_cnt; ++i) {
+            auto m = models_[i];
+            if (m.model_id == 0 || m.version == 0) {
+                LOG_ERROR << "bad model in file: " << file
+                          << ", model_id: " << m.model_id
+                          << ", version: " << m.version << std::endl;
+                return false;
+            }
+        }
+        const auto* bucket = reinterpret_cast<const typename L::Bucket*>(models_ + h->model_cnt);
+        const auto* entries = reinterpret_cast<const typename L::Ent*>(bucket + h->bucket_cnt);
+        SetTable(h, bucket, entries);
+        val_pool_    = reinterpret_cast<const char*>(entries + h->entry_cnt);
+        version_     = L::kVersion;
+        model_cnt_   = h->model_cnt;
+        bucket_cnt_  = h->bucket_cnt;
+        val_pool_sz_ = h->val_pool_sz;
+        mask_        = h->bucket_cnt ? (h->bucket_cnt - 1) : 0;
+        size_        = h->entry_cnt;
+        return true;
+    }
+
+    bool ValidateSwiss() {
+        const std::string& file = file_path_;
+        const auto* h = reinterpret_cast<const FrozenHeaderV3*>(base_);
+        if (map_size_ < sizeof(*h)) {
+            LOG_ERROR << "file too small: " << file << std::endl;
+            return false;
+        }
+        // 先把各计数限制在文件大小以内, 之后的布局计算不会溢出
+        const uint64_t fsz = map_size_;
+        const bool sane = h->model_cnt <= fsz / sizeof(Model) && h->group_cnt <= fsz / (kSwissGroup * sizeof(SlotV3)) &&
+                          h->val_pool_sz <= fsz;
+        const SwissLayout l = SwissLayoutOf(sane ? h->model_cnt : 0, sane ? h->group_cnt : 0, sane ? h->val_pool_sz : 0);
+        // 至少留一个空槽, 否则未命中的探测无法终止
+        if (!sane || l.end > fsz || h->group_cnt == 0 || (h->group_cnt & (h->group_cnt - 1)) != 0 ||
+            h->entry_cnt >= h->group_cnt * kSwissGroup) {
+            LOG_ERROR << "bad swiss layout in file: " << file
+                      << ", need: " << l.end << ", size: " << fsz
+                      << ", group count: " << h->group_cnt << ", entry count: " << h->entry_cnt << std::endl;
+            return false;
+        }
+        models_ = reinterpret_cast<const Model*>(base_ + sizeof(*h));
+        for (uint32_t i = 0; i < h->model_cnt; ++i) {
+            auto m = models_[i];
+            if (m.model_id == 0 || m.version == 0) {
+                LOG_ERROR << "bad model in file: " << file
+                          << ", model_id: " << m.model_id
+                          << ", version: " << m.version << std::endl;
+                return false;
+            }
+        }
+        ctrl_ = reinterpret_cast<const uint8_t*>(base_ + l.ctrl);
+        if (std::memcmp(ctrl_, ctrl_ + h->group_cnt * kSwissGroup, kSwissGroup) != 0) {
+            LOG_ERROR << "bad swiss ctrl tail in file: " << file << std::endl;
+            return false;
+        }
+        static const SwissProbe probe = DetectSwissProbe();
+        hdr3_        = h;
+        slots_       = reinterpret_cast<const SlotV3*>(base_ + l.slots);
+        val_pool_    = base_ + l.kv;
+        version_     = 3;
+        probe_       = probe;
+        model_cnt_   = h->model_cnt;
+        bucket_cnt_  = h->group_cnt;
+        val_pool_sz_ = h->val_pool_sz;
+        mask_        = h->group_cnt - 1;
+        size_        = h->entry_cnt;
+        return true;
+    }
+
+    bool SlotMatches(const SlotV3* s, uint64_t hash, std::string_view key) const {
+        return s->key_hash == hash && s->key_size == key.size() && s->kv_offset <= val_pool_sz_ &&
+               uint64_t(s->key_size) + s->value_size <= val_pool_sz_ - s->kv_offset &&
+               std::memcmp(val_pool_ + s->kv_offset, key.data(), key.size()) == 0;
+    }
+
+    // 从 home 组 (hash & mask_) 起逐组线性探测, 遇到含空槽的组即终止.
+    // 组内候选按槽序检查, 与 builder 的落位顺序一致 (重复 key 先出现者生效).
+    template <typename P>
+    __attribute__((always_inline)) inline const SlotV3* FindSwissT(uint64_t hash, std::string_view key) const {
+        const uint8_t h2 = SwissH2(hash);
+        uint64_t g = hash & mask_;
+        uint32_t skip = g & (P::kGroups - 1);   // home 在组对后半时, 首轮跳过前半
+        g -= skip;
+        for (uint64_t seen = 0; seen <= mask_; seen += P::kGroups - skip, skip = 0) {
+            uint32_t match, empty;
+            P::Match(ctrl_ + g * kSwissGroup, h2, &match, &empty);
+            for (uint32_t k = skip; k < P::kGroups; ++k) {
+                uint32_t m = (match >> (k * kSwissGroup)) & 0xffff;
+                const SlotV3* grp = slots_ + ((g + k) & mask_) * kSwissGroup;
+                while (m) {
+                    const SlotV3* s = grp + __builtin_ctz(m);
+                    if (SlotMatches(s, hash, key)) return s;
+                    m &= m - 1;
+                }
+                if ((empty >> (k * kSwissGroup)) & 0xffff) return nullptr;
+            }
+            g = (g + P::kGroups) & mask_;
+        }
+        return nullptr;
+    }
+
+    // 与 MultiGetT 相同的分组流水: hash -> ctrl -> 首个候选槽 -> kv, 每阶段先整组 prefetch
+    template <typename P>
+    __attribute__((always_inline)) inline size_t MultiGetSwissT(const std::string_view* keys, size_t n,
+                                                                std::string_view* out) const {
+        static const size_t kMultiGetGroup = 16;
+        uint64_t hash[kMultiGetGroup];
+        const SlotV3* cand[kMultiGetGroup];
+        size_t found = 0;
+        for (size_t base = 0; base < n; base += kMultiGetGroup) {
+            const size_t g = std::min(kMultiGetGroup, n - base);
+            for (size_t i = 0; i < g; ++i) {
+                hash[i] = HashKey64(keys[base + i]);
+                __builtin_prefetch(ctrl_ + (hash[i] & mask_) * kSwissGroup);
+            }
+            for (size_t i = 0; i < g; ++i) {
+                const uint64_t grp = hash[i] & mask_;
+                const uint32_t skip = grp & (P::kGroups - 1);
+                uint32_t match, empty;
+                P::Match(ctrl_ + (grp - skip) * kSwissGroup, SwissH2(hash[i]), &match, &empty);
+                match = (match >> (skip * kSwissGroup)) & 0xffff;
+                cand[i] = match ? slots_ + grp * kSwissGroup + __builtin_ctz(match) : nullptr;
+                if (cand[i]) __builtin_prefetch(cand[i]);
+            }
+            for (size_t i = 0; i < g; ++i) {
+                if (cand[i] && cand[i]->kv_offset < val_pool_sz_) __builtin_prefetch(val_pool_ + cand[i]->kv_offset);
+            }
+            for (size_t i = 0; i < g; ++i) {
+                const SlotV3* s = FindSwissT<P>(hash[i], keys[base + i]);
+                if (s) {
+                    SampleHeat(s->kv_offset);
+                    out[base + i] = std::string_view(val_pool_ + s->kv_offset + s->key_size, s->value_size);
+                    ++found;
+                } else {
+                    out[base + i] = std::string_view();
+                }
+            }
+        }
+        return found;
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    // AVX2 版本单独编译, 运行时仅在 CPU 支持时调用
+    __attribute__((target("avx2"))) const SlotV3* FindSwissAvx2(uint64_t hash, std::string_view key) const {
+        return FindSwissT<ProbeAvx2>(hash, key);
+    }
+    __attribute__((target("avx2"))) size_t MultiGetSwissAvx2(const std::string_view* keys, size_t n,
+                                                             std::string_view* out) const {
+        return MultiGetSwissT<ProbeAvx2>(keys, n, out);
+    }
+#endif
+
+    void SetTable(const FrozenHeader* h, const uint32_t* b, const Entry* e) { hdr_ = h, bucket_ = b, entries_ = e; }
+    void SetTable(const FrozenHeaderV2* h, const uint64_t* b, const EntryV2* e) { hdr2_ = h, bucket2_ = b, entries2_ = e; }
+    const uint32_t* Buckets(LayoutV1) const { return bucket_; }
+    const uint64_t* Buckets(LayoutV2) const { return bucket2_; }
+    const Entry* Entries(LayoutV1) const { return entries_; }
+    const EntryV2* Entries(LayoutV2) const { return entries2_; }
+
+    template <typename L>
+    const typename L::Ent* FindT(uint64_t hash) const {
+        const auto* bucket = Buckets(L{});
+        const auto* entries = Entries(L{});
+        if (!bucket || bucket_cnt_ == 0) return nullptr;
+        const auto tag = L::Tag(hash);
+        uint64_t b = tag & mask_;
+        uint64_t begin = bucket[b];
+        uint64_t end = std::min<uint64_t>((b == mask_) ? size_ : bucket[b + 1], size_);
+        for (uint64_t i = begin; i < end; ++i) {
+            if (entries[i].key_hash == tag) return &entries[i];
+        }
+        return nullptr;
+    }
+
+    template <typename L>
+    bool GetT(std::string_view key, std::string_view* value) const {
+        const auto* e = FindT<L>(HashKey64(key));
+        if (!e) return false;
+        if (e->value_offset > val_pool_sz_ || e->value_size > val_pool_sz_ - e->value_offset) return false;
+        SampleHeat(e->value_offset);
+        *value = std::string_view(val_pool_ + e->value_offset, e->value_size);
+        return true;
+    }
+
+    template <typename L>
+    size_t MultiGetT(const std::string_view* keys, size_t n, std::string_view* out) const {
+        static const size_t kMultiGetGroup = 16;
+        using Tag = decltype(L::Tag(0));
+        const auto* bucket = Buckets(L{});
+        const auto* entries = Entries(L{});
+        if (!bucket || bucket_cnt_ == 0) {
+            for (size_t i = 0; i < n; ++i) out[i] = std::string_view();
+            return 0;
+        }
+        Tag hash[kMultiGetGroup];
+        uint64_t begin[kMultiGetGroup];
+        uint64_t end[kMultiGetGroup];
+        const typename L::Ent* hit[kMultiGetGroup];
+        size_t found = 0;
+        for (size_t base = 0; base < n; base += kMultiGetGroup) {
+            const size_t g = std::min(kMultiGetGroup, n - base);
+            for (size_t i = 0; i < g; ++i) {
+                hash[i] = L::Tag(HashKey64(keys[base + i]));
+                __builtin_prefetch(&bucket[hash[i] & mask_]);
+            }
+            for (size_t i = 0; i < g; ++i) {
+                uint64_t b = hash[i] & mask_;
+                begin[i] = bucket[b];
+                end[i] = std::min<uint64_t>((b == mask_) ? size_ : bucket[b + 1], size_);
+                if (begin[i] < end[i]) __builtin_prefetch(&entries[begin[i]]);
+            }
+            for (size_t i = 0; i < g; ++i) {
+                hit[i] = nullptr;
+                for (uint64_t j = begin[i]; j < end[i]; ++j) {
+                    if (entries[j].key_hash == hash[i]) { hit[i] = &entries[j]; break; }
+                }
+                if (hit[i]) __builtin_prefetch(val_pool_ + hit[i]->value_offset);
+            }
+            for (size_t i = 0; i < g; ++i) {
+                const auto* e = hit[i];
+                if (e && e->value_offset <= val_pool_sz_ && e->value_size <= val_pool_sz_ - e->value_offset) {
+                    SampleHeat(e->value_offset);
+                    out[base + i] = std::string_view(val_pool_ + e->value_offset, e->value_size);
+                    ++found;
+                } else {
+                    out[base + i] = std::string_view();
+                }
+            }
+        }
+        return found;
+    }
+
+    void SampleHeat(uint64_t value_offset) const {
+        if (!heat_) return;
+        thread_local uint32_t tick = 0;
+        if ((++tick & (kHeatSample - 1)) == 0)
+            heat_[value_offset >> kHeatShift].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::string file_path_;
+    std::unique_ptr<LoadBackend> source_;
+
+    const char* base_{nullptr};
+    uint64_t map_size_{0};
+    const Header* hdr_{nullptr};            // v1
+    const FrozenHeaderV2* hdr2_{nullptr};   // v2
+    const Model* models_{nullptr};
+    const uint32_t* bucket_{nullptr};
+    const Entry* entries_{nullptr};
+    const uint64_t* bucket2_{nullptr};
+    const EntryV2* entries2_{nullptr};
+    const FrozenHeaderV3* hdr3_{nullptr};   // v3 (swiss)
+    const uint8_t* ctrl_{nullptr};
+    const SlotV3* slots_{nullptr};
+    SwissProbe probe_{SwissProbe::kScalar};
+    const char* val_pool_{nullptr};
+    uint32_t version_{0};
+    uint32_t model_cnt_{0};
+    uint64_t bucket_cnt_{0};
+    uint64_t val_pool_sz_{0};
+    uint64_t mask_{0};
+    uint64_t size_{0};
+    std::unique_ptr<std::atomic<uint32_t>[]> heat_;
+    size_t heat_n_{0};
+};
+
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif
+
+// === 快照发布 + epoch 回收 (RCU) ===
+// 读者: Acquire() 在本线程 slot 写入当前 epoch 后再读快照指针, 全程无锁.
+// 写者: Publish() 交换指针并推进 epoch, 旧表挂到 retired_, 直到所有活跃 slot
+// 的 epoch 都晚于退休 epoch 才析构 (munmap), 因此读者不会访问已释放的映射.
+class EpochDomain {
+public:
+    static EpochDomain& Instance() {
+        static EpochDomain d;
+        return d;
+    }
+
+    void Enter() {
+        Local& l = LocalSlot();
+        if (l.depth++ == 0)
+            slots_[l.index].epoch.store(global_.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+    }
+    void Exit() {
+        Local& l = LocalSlot();
+        if (--l.depth == 0) slots_[l.index].epoch.store(0, std::memory_order_release);
+    }
+    // 推进 epoch, 返回推进前的值 (作为退休 epoch)
+    uint64_t Advance() { return global_.fetch_add(1, std::memory_order_seq_cst); }
+    // 所有活跃读者中最小的 epoch; 无活跃读者返回 UINT64_MAX
+    uint64_t MinActive() const {
+        uint64_t m = UINT64_MAX;
+        for (const auto& s : slots_) {
+            uint64_t e = s.epoch.load(std::memory_order_seq_cst);
+            if (e != 0 && e < m) m = e;
+        }
+        return m;
+    }
+
+private:
+    static const int kSlots = 1024;
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch{0};
+        std::atomic<bool> used{false};
+    };
+    struct Local {
+        int index{-1};
+        int depth{0};
+        ~Local() { if (index >= 0) Instance().slots_[index].used.store(false, std::memory_order_release); }
+    };
+    Local& LocalSlot() {
+        thread_local Local l;
+        if (l.index < 0) {
+            for (int i = 0; i < kSlots; ++i) {
+                bool expect = false;
+                if (slots_[i].used.compare_exchange_strong(expect, true)) { l.index = i; break; }
+            }
+            if (l.index < 0) {
+                LOG_ERROR << "epoch slots exhausted (" << kSlots << " reader threads)" << std::endl;
+                std::abort();
+            }
+        }
+        return l;
+    }
+
+    std::atomic<uint64_t> global_{1};
+    Slot slots_[kSlots];
+};
+
+class TableSnapshot {
+public:
+    class ReadGuard {
+    public:
+        ReadGuard() = default;
+        explicit ReadGuard(const FrozenHashMapImpl* t) : table_(t), active_(true) {}
+        ReadGuard(ReadGuard&& o) noexcept : table_(o.table_), active_(o.active_) { o.active_ = false; }
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+        ~ReadGuard() { if (active_) EpochDomain::Instance().Exit(); }
+
+        const FrozenHashMapImpl* operator->() const { return table_; }
+        const FrozenHashMapImpl* get() const { return table_; }
+        explicit operator bool() const { return table_ != nullptr; }
+
+    private:
+        const FrozenHashMapImpl* table_{nullptr};
+        bool active_{false};
+    };
+
+    ~TableSnapshot() {
+        delete current_.exchange(nullptr);
+    }
+
+    ReadGuard Acquire() const {
+        EpochDomain::Instance().Enter();
+        return ReadGuard(current_.load(std::memory_order_seq_cst));
+    }
+
+    void Publish(std::unique_ptr<FrozenHashMapImpl> next) {
+        const FrozenHashMapImpl* old = current_.exchange(next.release(), std::memory_order_seq_cst);
+        uint64_t retire_epoch = EpochDomain::Instance().Advance();
+        if (old) {
+            std::lock_guard<std::mutex> lk(mu_);
+            retired_.emplace_back(retire_epoch, std::unique_ptr<const FrozenHashMapImpl>(old));
+        }
+        Reclaim();
+    }
+
+    // 释放已无读者的旧版本, 返回仍待回收的数量
+    size_t Reclaim() {
+        uint64_t min_active = EpochDomain::Instance().MinActive();
+        std::vector<std::unique_ptr<const FrozenHashMapImpl>> drop;
+        size_t pending = 0;
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            auto it = std::partition(retired_.begin(), retired_.end(),
+                                     [&](const auto& r) { return r.first >= min_active; });
+            for (auto d = it; d != retired_.end(); ++d) drop.push_back(std::move(d->second));
+            retired_.erase(it, retired_.end());
+            pending = retired_.size();
+        }
+        for (auto& d : drop) LOG_INFO << "Release retired table: " << d->FilePath() << std::endl;
+        return pending;
+    }
+
+private:
+    std::atomic<const FrozenHashMapImpl*> current_{nullptr};
+    std::mutex mu_;
+    std::vector<std::pair<uint64_t, std::unique_ptr<const FrozenHashMapImpl>>> retired_;
+};
+
+// === 节点本地缓存 (内容寻址) ===
+// 同节点多个 reader 共用 LOCAL_CACHE_DIR (本地盘 / tmpfs): v2 manifest 目标以 <xxh64>-<size>
+// 命名复制一次, 之后各进程从本地映射, 冷启动 / 轮换只消耗一份 blob 带宽.
+//   <key>        完整条目; 使用中的进程持有 LOCK_SH, 淘汰方 LOCK_EX|LOCK_NB 失败即跳过
+//   <key>.lock   填充锁: 拿到 LOCK_EX 的进程复制, 其余等待后直接命中
+//   <key>.part   填充中的数据, 与 manifest checksum 比对后 rename 为 <key>
+//   .evict.lock  淘汰互斥
+// 条目 mtime 作 LRU 时间 (命中时 touch); 超出 budget 或剩余空间不足时从最旧的开始删.
+// 分段容器 (STRATSEG) 按名字引用同目录的其他文件, 不进缓存.
+class LocalCache {
+public:
+    ~LocalCache() { Retain({}); }
+
+    bool Open(const std::string& dir, uint64_t budget) {
+        if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+            LOG_ERROR << "[cache] mkdir fail: " << dir << " err=" << std::strerror(errno) << std::endl;
+            return false;
+        }
+        dir_ = dir;
+        budget_ = budget;
+        return true;
+    }
+    bool Enabled() const { return !dir_.empty(); }
+
+    // 内容地址; 空 = 不可缓存 (v1 manifest / 无 checksum)
+    static std::string Key(const ManifestInfo& m) {
+        if (m.version < 2 || !m.has_checksum || !m.size) return "";
+        char buf[48];
+        std::snprintf(buf, sizeof(buf), "%016llx-%llu", (unsigned long long)m.checksum, (unsigned long long)m.size);
+        return buf;
+    }
+
+    // 命中或复制完成后返回本地路径, 并持有该条目的 LOCK_SH 直到 Retain 不再包含它;
+    // 不可缓存 / 空间不足 / 复制失败返回空串, 调用方回退到远端目标
+    std::string Acquire(const ManifestInfo& m, const PrefetchOptions& opt, const std::atomic<bool>* cancel) {
+        const std::string key = Key(m);
+        if (!Enabled() || key.empty()) return "";
+        if (IsSegmentedFile(m.target)) {
+            LOG_INFO << "[cache] " << m.target << " is a segmented container, not cached" << std::endl;
+            return "";
+        }
+        const std::string path = dir_ + "/" + key;
+        bool filled = false;
+        for (int attempt = 0; attempt < 3; ++attempt) {
+            if (Pin(key, path)) {
+                if (!filled) {
+                    Metrics::Instance().Set("frozen_cache_hits", double(++hits_));
+                    LOG_INFO << "[cache] hit " << key << " for " << m.target << std::endl;
+                }
+                return path;
+            }
+            // 未命中: 抢填充锁; 等到锁时别的进程可能已经填好
+            int lk = LockFile(path + ".lock", cancel);
+            if (lk < 0) return "";
+            bool ok = ::access(path.c_str(), F_OK) == 0;
+            if (!ok) filled = ok = Fill(m, key, path, opt, cancel);
+            ::close(lk);
+            if (!ok) return "";
+        }
+        return "";
+    }
+
+    // 只保留 keys 的 LOCK_SH, 其余条目交给 LRU 淘汰
+    void Retain(const std::set<std::string>& keys) {
+        std::lock_guard<std::mutex> lk(mu_);
+        for (auto it = pinned_.begin(); it != pinned_.end();) {
+            if (keys.count(it->first)) {
+                ++it;
+                continue;
+            }
+            ::close(it->second);
+            it = pinned_.erase(it);
+        }
+    }
+
+    // 条目内容被判坏 (校验失败): 放掉并删除, 下次重新从远端复制
+    void Drop(const ManifestInfo& m) {
+        const std::string key = Key(m);
+        if (!Enabled() || key.empty()) return;
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            auto it = pinned_.find(key);
+            if (it != pinned_.end()) {
+                ::close(it->second);
+                pinned_.erase(it);
+            }
+        }
+        if (std::remove((dir_ + "/" + key).c_str()) == 0) LOG_INFO << "[cache] dropped " << key << std::endl;
+    }
+
+private:
+    bool Pin(const std::string& key, const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return false;
+        struct stat st{};
+        // 淘汰方持 LOCK_EX 时先 unlink 再释放, 拿到共享锁后 nlink == 0 说明已被删
+        if (flock(fd, LOCK_SH) != 0 || fstat(fd, &st) != 0 || st.st_nlink == 0) {
+            ::close(fd);
+            return false;
+        }
+        futimens(fd, nullptr);   // LRU
+        std::lock_guard<std::mutex> lk(mu_);
+        if (!pinned_.emplace(key, fd).second) ::close(fd);
+        return true;
+    }
+
+    static int LockFile(const std::string& path, const std::atomic<bool>* cancel) {
+        int fd = ::open(path.c_str(), O_CREAT | O_RDWR | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            LOG_ERROR << "[cache] open fail: " << path << " err=" << std::strerror(errno) << std::endl;
+            return -1;
+        }
+        for (bool logged = false; flock(fd, LOCK_EX | LOCK_NB) != 0;) {
+            if (errno != EWOULDBLOCK && errno != EINTR) {
+                LOG_ERROR << "[cache] flock fail: " << path << " err=" << std::strerror(errno) << std::endl;
+                ::close(fd);
+                return -1;
+            }
+            if (cancel && cancel->load()) {
+                ::close(fd);
+                return -1;
+            }
+            if (!logged) LOG_INFO << "[cache] waiting for another reader filling " << path << std::endl;
+            logged = true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        return fd;
+    }
+
+    // 远端 -> <key>.part: 按预取块并行 pread 进共享映射, 整体 XXH64 对上 manifest 再 rename
+    bool Fill(const ManifestInfo& m, const std::string& key, const std::string& path, const PrefetchOptions& opt,
+              const std::atomic<bool>* cancel) {
+        if (!MakeRoom(m.size)) {
+            LOG_INFO << "[cache] no room for " << key << " (" << m.size << " bytes), reading remote" << std::endl;
+            return false;
+        }
+        auto t0 = std::chrono::steady_clock::now();
+        const std::string part = path + ".part";
+        int src = ::open(m.target.c_str(), O_RDONLY | O_CLOEXEC);
+        int dst = ::open(part.c_str(), O_CREAT | O_RDWR | O_TRUNC | O_CLOEXEC, 0644);
+        struct stat st{};
+        bool ok = src >= 0 && dst >= 0 && fstat(src, &st) == 0 && uint64_t(st.st_size) == m.size;
+        if (!ok) LOG_ERROR << "[cache] open fail: " << m.target << " -> " << part << std::endl;
+        if (ok && posix_fallocate(dst, 0, (off_t)m.size) != 0) {
+            LOG_ERROR << "[cache] fallocate fail: " << part << " size=" << m.size << std::endl;
+            ok = false;
+        }
+        void* p = ok ? mmap(nullptr, m.size, PROT_READ | PROT_WRITE, MAP_SHARED, dst, 0) : MAP_FAILED;
+        ok = p != MAP_FAILED;
+        PrefetchStats stats;
+        if (ok) {
+            char* base = static_cast<char*>(p);
+            PrefetchOptions copy = opt;
+            copy.progress = nullptr;
+            copy.verify = nullptr;
+            const FileAccess& io = FileAccess::For(m.target);
+            ok = PrefetchEngine::RunChunks(m.size, copy, cancel, &stats,
+                                           [&](uint64_t off, uint64_t n) { return PreadAll(src, base + off, n, off, io); });
+            uint64_t got = ok ? Xxh64::Hash(base, m.size) : 0;
+            if (ok && got != m.checksum) {
+                LOG_ERROR << "[cache] " << m.target << " checksum " << std::hex << got << " != manifest "
+                          << m.checksum << std::dec << std::endl;
+                ok = false;
+            }
+            munmap(p, m.size);
+        }
+        if (ok) ok = fdatasync(dst) == 0;
+        if (src >= 0) ::close(src);
+        if (dst >= 0) ::close(dst);
+        if (ok) ok = std::rename(part.c_str(), path.c_str()) == 0;
+        if (!ok) {
+            std::remove(part.c_str());
+            if (!(cancel && cancel->load())) LOG_ERROR << "[cache] fill fail: " << key << std::endl;
+            return false;
+        }
+        Metrics::Instance().Set("frozen_cache_fills", double(++fills_));
+        LOG_INFO << "[cache] filled " << key << " from " << m.target << " bytes=" << m.size << " threads=" << opt.threads
+                 << " cost=" << std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() << "s"
+                 << " throughput=" << stats.GiBps() << "GiB/s" << std::endl;
+        return true;
+    }
+
+    // 按 mtime 从旧到新删除未被任何进程持有的条目, 直到 incoming 放得下
+    bool MakeRoom(uint64_t incoming) {
+        int lk = ::open((dir_ + "/.evict.lock").c_str(), O_CREAT | O_RDWR | O_CLOEXEC, 0644);
+        if (lk < 0 || flock(lk, LOCK_EX) != 0) {
+            if (lk >= 0) ::close(lk);
+            return false;
+        }
+        struct Item { std::string name; uint64_t size; time_t mtime; };
+        std::vector<Item> items;
+        uint64_t used = 0;
+        if (DIR* d = opendir(dir_.c_str())) {
+            while (struct dirent* e = readdir(d)) {
+                std::string name = e->d_name;
+                struct stat st{};
+                if (name.empty() || name[0] == '.' || stat((dir_ + "/" + name).c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+                    continue;
+                if (name.find('.') == std::string::npos) {
+                    items.push_back({name, uint64_t(st.st_size), st.st_mtime});
+                    used += st.st_size;
+                } else if (name.size() > 5 && name.compare(name.size() - 5, 5, ".part") == 0) {
+                    // 崩溃残留: 填充锁无人持有即可删
+                    std::string key = name.substr(0, name.size() - 5);
+                    int f = ::open((dir_ + "/" + key + ".lock").c_str(), O_RDWR | O_CLOEXEC);
+                    if (f >= 0 && flock(f, LOCK_EX | LOCK_NB) == 0) std::remove((dir_ + "/" + name).c_str());
+                    if (f >= 0) ::close(f);
+                }
+            }
+            closedir(d);
+        }
+        std::sort(items.begin(), items.end(), [](const Item& a, const Item& b) { return a.mtime < b.mtime; });
+        auto avail = [&] {
+            struct statvfs vs{};
+            return statvfs(dir_.c_str(), &vs) == 0 ? uint64_t(vs.f_bavail) * vs.f_frsize : 0;
+        };
+        auto fits = [&] { return (!budget_ || used + incoming <= budget_) && avail() >= incoming; };
+        for (const auto& it : items) {
+            if (fits()) break;
+            const std::string path = dir_ + "/" + it.name;
+            int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) continue;
+            if (flock(fd, LOCK_EX | LOCK_NB) == 0 && std::remove(path.c_str()) == 0) {
+                used -= it.size;
+                LOG_INFO << "[cache] evicted " << it.name << " bytes=" << it.size << std::endl;
+            }
+            ::close(fd);
+        }
+        bool ok = fits();
+        Metrics::Instance().Set("frozen_cache_bytes", double(used + (ok ? incoming : 0)));
+        ::close(lk);
+        return ok;
+    }
+
+    std::string dir_;
+    uint64_t budget_ = 0;   // 0 = 只受剩余空间限制
+    std::mutex mu_;
+    std::map<std::string, int> pinned_;   // key -> 持 LOCK_SH 的 fd
+    std::atomic<uint64_t> hits_{0}, fills_{0};
+};
+
+// === 节点内共享加载 (SHARE_SOCKET) ===
+// <socket>.lock 上 flock 选出唯一加载进程 (leader): 它监听 Unix socket, 自己用 memfd 后端加载版本,
+// promote 后 Publish(内容地址, memfd, 是否已校验); 其余进程 (follower) 发 "GET <key>\n", 收到
+// "OK <0|1>\n" + SCM_RIGHTS 携带的 fd 后只读映射 (0 = leader 未校验, follower 自己校验), 尚未就绪时
+// 回 "MISS\n" 并重试, leader 加载失败时回 "FAIL\n", follower 立即自行加载. leader 退出即释放锁,
+// follower 在下一次取 fd 或 housekeeping 时接任; 已拿到的 memfd 与 leader 生命周期无关, 照常服务.
+class ShareHub {
+public:
+    ~ShareHub() {
+        running_ = false;
+        if (server_.joinable()) server_.join();
+        if (listen_fd_ >= 0) {
+            ::close(listen_fd_);
+            ::unlink(path_.c_str());
+        }
+        if (lock_fd_ >= 0) ::close(lock_fd_);
+        Retain({});
+    }
+
+    // 路径放不进 sun_path 时关闭共享 (各自加载), 不去抢选举锁
+    void Open(const std::string& socket_path) {
+        if (socket_path.size() >= sizeof(sockaddr_un::sun_path)) {
+            LOG_ERROR << "[share] socket path too long, sharing disabled: " << socket_path << std::endl;
+            return;
+        }
+        path_ = socket_path;
+        TryElect();
+    }
+    bool Enabled() const { return !path_.empty(); }
+    bool Leader() const { return listen_fd_ >= 0; }
+
+    // 未当选时尝试接任: 拿到选举锁才 bind, 残留的 socket 文件属于已退出的 leader
+    bool TryElect() {
+        if (!Enabled() || Leader()) return Leader();
+        std::lock_guard<std::mutex> elk(elect_mu_);   // loader 线程 (Fetch) 与 watch 线程都会调用
+        if (Leader()) return true;
+        if (lock_fd_ < 0) lock_fd_ = ::open((path_ + ".lock").c_str(), O_CREAT | O_RDWR | O_CLOEXEC, 0600);
+        if (lock_fd_ < 0 || flock(lock_fd_, LOCK_EX | LOCK_NB) != 0) return false;
+        struct sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, path_.c_str(), path_.size());
+        ::unlink(path_.c_str());
+        int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0 || ::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(fd, 64) != 0) {
+            LOG_ERROR << "[share] listen fail: " << path_ << " err=" << std::strerror(errno) << std::endl;
+            if (fd >= 0) ::close(fd);
+            flock(lock_fd_, LOCK_UN);
+            return false;
+        }
+        ::chmod(path_.c_str(), 0600);
+        listen_fd_ = fd;
+        running_ = true;
+        server_ = std::thread(&ShareHub::Serve, this);
+        LOG_INFO << "[share] elected loader, serving " << path_ << std::endl;
+        return true;
+    }
+
+    // 登记可交出的版本 (dup 一份, 与表对象生命周期解耦)
+    void Publish(const std::string& key, int fd, bool verified) {
+        if (!Enabled() || key.empty() || fd < 0) return;
+        int dup = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+        if (dup < 0) return;
+        std::lock_guard<std::mutex> lk(mu_);
+        auto it = fds_.find(key);
+        if (it != fds_.end()) ::close(it->second.fd);
+        fds_[key] = Entry{dup, verified};
+        failed_.erase(key);
+    }
+
+    // 登记本进程加载 key 失败 (读取 / 校验), 等待中的 follower 不必等到 SHARE_WAIT_SEC
+    void Fail(const std::string& key) {
+        if (!Enabled() || key.empty()) return;
+        std::lock_guard<std::mutex> lk(mu_);
+        if (!fds_.count(key)) failed_.insert(key);
+    }
+
+    void Retain(const std::set<std::string>& keys) {
+        std::lock_guard<std::mutex> lk(mu_);
+        for (auto it = fds_.begin(); it != fds_.end();) {
+            if (keys.count(it->first)) {
+                ++it;
+                continue;
+            }
+            ::close(it->second.fd);
+            it = fds_.erase(it);
+        }
+        for (auto it = failed_.begin(); it != failed_.end();) it = keys.count(*it) ? std::next(it) : failed_.erase(it);
+    }
+
+    // follower 取 key 的 memfd (*verified: leader 是否校验过); 本进程当选 / leader 加载失败 / 超时 /
+    // 取消时返回 -1, 由调用方自己加载
+    int Fetch(const std::string& key, const std::atomic<bool>* cancel, int wait_sec, bool* verified) {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(wait_sec);
+        for (bool logged = false; std::chrono::steady_clock::now() < deadline;) {
+            if (TryElect() || (cancel && cancel->load())) return -1;
+            bool failed = false;
+            int fd = Request(key, verified, &failed);
+            if (fd >= 0) return fd;
+            if (failed) {
+                LOG_ERROR << "[share] loader failed to load " << key << ", loading locally" << std::endl;
+                return -1;
+            }
+            if (!logged) LOG_INFO << "[share] waiting for loader to publish " << key << std::endl;
+            logged = true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        LOG_ERROR << "[share] " << key << " not published within " << wait_sec << "s, loading locally" << std::endl;
+        return -1;
+    }
+
+private:
+    int Request(const std::string& key, bool* verified, bool* failed) {
+        struct sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, path_.c_str(), path_.size());   // 长度已在 Open 检查
+        int s = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (s < 0) return -1;
+        struct timeval tv{2, 0};
+        ::setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        const std::string req = "GET " + key + "\n";
+        int got = -1;
+        if (::connect(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0 &&
+            ::send(s, req.data(), req.size(), MSG_NOSIGNAL) == ssize_t(req.size())) {
+            char buf[16] = {0};
+            alignas(struct cmsghdr) char ctl[CMSG_SPACE(sizeof(int))];
+            struct iovec iov{buf, sizeof(buf) - 1};
+            struct msghdr msg{};
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            msg.msg_control = ctl;
+            msg.msg_controllen = sizeof(ctl);
+            ssize_t n = ::recvmsg(s, &msg, MSG_CMSG_CLOEXEC);
+            struct cmsghdr* c = n > 0 ? CMSG_FIRSTHDR(&msg) : nullptr;
+            if (c && c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_RIGHTS) {
+                std::memcpy(&got, CMSG_DATA(c), sizeof(int));
+                if (std::strncmp(buf, "OK ", 3) != 0) {
+                    ::close(got);
+                    got = -1;
+                }
+                *verified = got >= 0 && buf[3] == '1';
+            }
+            *failed = n > 0 && std::strncmp(buf, "FAIL\n", 5) == 0;
+        }
+        ::close(s);
+        return got;
+    }
+
+    // 单线程逐个应答: 请求只有一行, 应答是一次 sendmsg
+    void Serve() {
+        while (running_) {
+            struct pollfd pfd{listen_fd_, POLLIN, 0};
+            if (::poll(&pfd, 1, 200) <= 0) continue;
+            int c = ::accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+            if (c < 0) continue;
+            struct ucred cred{};
+            socklen_t len = sizeof(cred);
+            if (::getsockopt(c, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0 || (cred.uid != getuid() && cred.uid != 0)) {
+                ::close(c);
+                continue;
+            }
+            struct timeval tv{1, 0};
+            ::setsockopt(c, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+            std::string line;
+            char ch;
+            while (line.size() < 256 && ::recv(c, &ch, 1, 0) == 1 && ch != '\n') line.push_back(ch);
+            int fd = -1;
+            bool verified = false, failed = false;
+            if (line.compare(0, 4, "GET ") == 0) {
+                std::lock_guard<std::mutex> lk(mu_);
+                auto it = fds_.find(line.substr(4));
+                if (it != fds_.end()) {
+                    fd = ::fcntl(it->second.fd, F_DUPFD_CLOEXEC, 0);
+                    verified = it->second.verified;
+                }
+                failed = fd < 0 && failed_.count(line.substr(4));
+            }
+            Reply(c, fd, verified, failed);
+            if (fd >= 0) {
+                ::close(fd);
+                served_++;
+                Metrics::Instance().Set("frozen_share_handouts", double(served_));
+                LOG_INFO << "[share] handed " << line.substr(4) << " to pid=" << cred.pid << std::endl;
+            }
+            ::close(c);
+        }
+    }
+
+    static void Reply(int c, int fd, bool verified, bool failed) {
+        const char* msg_text = fd >= 0 ? (verified ? "OK 1\n" : "OK 0\n") : failed ? "FAIL\n" : "MISS\n";
+        struct iovec iov{const_cast<char*>(msg_text), std::strlen(msg_text)};
+        struct msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        alignas(struct cmsghdr) char ctl[CMSG_SPACE(sizeof(int))] = {};
+        if (fd >= 0) {
+            msg.msg_control = ctl;
+            msg.msg_controllen = sizeof(ctl);
+            struct cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+            cm->cmsg_level = SOL_SOCKET;
+            cm->cmsg_type = SCM_RIGHTS;
+            cm->cmsg_len = CMSG_LEN(sizeof(int));
+            std::memcpy(CMSG_DATA(cm), &fd, sizeof(int));
+        }
+        ::sendmsg(c, &msg, MSG_NOSIGNAL);
+    }
+
+    std::string path_;
+    int lock_fd_{-1};
+    std::mutex elect_mu_;
+    std::atomic<int> listen_fd_{-1};
+    std::atomic<bool> running_{false};
+    std::thread server_;
+    struct Entry {
+        int fd;           // 已封存 memfd
+        bool verified;    // leader 加载时做过分块 / 全量校验
+    };
+    std::mutex mu_;
+    std::map<std::string, Entry> fds_;   // 内容地址 -> 可交出的版本
+    std::set<std::string> failed_;       // 本进程加载失败的内容地址
+    uint64_t served_{0};
+};
+
+// === 后台分阶段加载: map -> validate -> prefetch(限速) -> promote ===
+// 加载在独立线程进行, 期间旧版本继续服务; 常驻比例达到阈值才 Publish.
+struct StagedLoadOptions {
+    LoadBackendOptions backend;        // mmap / pread / uring
+    PrefetchOptions prefetch;          // 并发/块大小/带宽预算
+    double promote_residency = 0.95;   // promote 所需常驻比例
+    uint64_t residency_budget = 0;     // 常驻内存预算 (字节), 0 = 整表常驻
+    int warm_rounds = 3;               // 未达阈值时最多预热轮数
+    bool verify_checksum = false;      // 预热后按 manifest checksum 全量校验
+    bool verify_segments = true;       // 首轮预热时逐块校验段表 / 校验尾中的 XXH64
+    int share_wait_sec = 120;          // follower 等 leader 登记 memfd 的上限, 超时自行加载
+    bool handoff = false;              // 重启交接开启: pread/uring 改读入 memfd, 表才能交给新进程
+};
+
+class StagedLoader {
+public:
+    // cache 非空且启用时先把目标复制到节点本地缓存, 再从本地映射;
+    // hub 启用时 follower 向 leader 取已封存的 memfd, leader 用 memfd 后端加载并登记
+    StagedLoader(TableSnapshot& snapshot, const StagedLoadOptions& opt, LocalCache* cache = nullptr,
+                 ShareHub* hub = nullptr)
+        : snapshot_(snapshot), opt_(opt), cache_(cache), hub_(hub) {}
+    ~StagedLoader() { Stop(); }
+
+    // 启动加载; 若有进行中的加载先取消. want 为 v2 manifest 时做 size/sections/checksum 校验.
+    // 已 promote 未 TakeLoaded 的版本保留 (它已在服务), 调用方应先取走再启动
+    void Start(const ManifestInfo& want, time_t mtime) {
+        Stop();
+        cancel_ = false;
+        busy_ = true;
+        worker_ = std::thread(&StagedLoader::Run, this, want, mtime);
+    }
+
+    // 接管前任进程交来的表 fd (memfd 或模型文件); 前任已校验过内容, 本进程不再校验
+    void Adopt(const ManifestInfo& want, time_t mtime, int fd, bool memfd) {
+        Stop();
+        adopt_fd_ = fd;
+        adopt_memfd_ = memfd;
+        Start(want, mtime);
+    }
+
+    void Stop() {
+        cancel_ = true;
+        if (worker_.joinable()) worker_.join();
+        busy_ = false;
+    }
+
+    bool Busy() const { return busy_.load(); }
+
+    // 既无进行中的加载, 也无待取的 promote; 同一把锁下判断, 刚结束的加载不会被看成空闲
+    bool Idle() {
+        std::lock_guard<std::mutex> lk(mu_);
+        return !busy_ && !loaded_;
+    }
+
+    // 有新 promote 的版本时返回 true, 并给出实际发布的 manifest 与启动时记录的 mtime
+    bool TakeLoaded(ManifestInfo* m, time_t* mtime) {
+        std::lock_guard<std::mutex> lk(mu_);
+        if (!loaded_) return false;
+        loaded_ = false;
+        *m = loaded_info_;
+        *mtime = loaded_mtime_;
+        return true;
+    }
+
+private:
+    void Run(ManifestInfo want, time_t mtime) {
+        const std::string& target = want.target;
+        using clock = std::chrono::steady_clock;
+        auto t_begin = clock::now();
+        auto t_stage = t_begin;
+        auto stage_done = [&](const char* stage) {
+            auto now = clock::now();
+            LOG_INFO << "[load] " << target << " stage=" << stage
+                     << " cost=" << std::chrono::duration<double>(now - t_stage).count() << "s" << std::endl;
+            t_stage = now;
+        };
+        std::string path = target;   // 命中本地缓存时为缓存条目, 接管文件时为 /proc/self/fd/N
+        bool from_cache = false;
+        LoadBackendOptions bopt = opt_.backend;
+        const int adopt_fd = adopt_fd_;
+        const bool adopt_memfd = adopt_memfd_;
+        adopt_fd_ = -1;
+        const std::string key = LocalCache::Key(want);   // 内容地址, 兼作共享 key
+        const bool share = adopt_fd < 0 && hub_ && hub_->Enabled() && !key.empty() && !IsSegmentedFile(target);
+        auto fail = [&](const char* stage) {
+            LOG_ERROR << "[load] " << target << " stage=" << stage << " failed, keep current version" << std::endl;
+            if (from_cache && cache_ && std::strcmp(stage, "verify") == 0) cache_->Drop(want);
+            if (share && bopt.shared_fd < 0) hub_->Fail(key);   // 本进程是加载方: 通知等待中的 follower
+            busy_ = false;
+        };
+
+        if (share && !hub_->Leader()) {
+            bopt.shared_fd = hub_->Fetch(key, &cancel_, opt_.share_wait_sec, &bopt.shared_verified);
+            if (bopt.shared_fd >= 0) LOG_INFO << "[load] " << target << " shared memfd from loader" << std::endl;
+        }
+        if (cancel_) {
+            if (adopt_fd >= 0) ::close(adopt_fd);
+            LOG_INFO << "[load] " << target << " cancelled" << std::endl;
+            busy_ = false;
+            return;
+        }
+        if (adopt_fd >= 0 && adopt_memfd) {
+            bopt.shared_fd = adopt_fd;
+        } else if (adopt_fd >= 0) {
+            path = "/proc/self/fd/" + std::to_string(adopt_fd);   // 同一文件, page cache 仍热
+            bopt.kind = "mmap";
+            bopt.huge_pages = HugePageMode::kOff;
+        } else if (share && bopt.shared_fd < 0) {
+            bopt.kind = "memfd";   // 本进程就是 (或刚接任) leader
+        } else if (opt_.handoff && (bopt.kind == "pread" || bopt.kind == "uring") &&
+                   bopt.huge_pages == HugePageMode::kOff) {
+            bopt.kind = "memfd";   // 匿名缓冲交不出去
+        }
+        if (cache_ && cache_->Enabled() && bopt.shared_fd < 0 && adopt_fd < 0) {
+            std::string local = cache_->Acquire(want, opt_.prefetch, &cancel_);
+            if (cancel_) {
+                LOG_INFO << "[load] " << target << " cancelled" << std::endl;
+                busy_ = false;
+                return;
+            }
+            if (!local.empty()) {
+                path = local;
+                from_cache = true;
+                LOG_INFO << "[load] " << target << " cache=" << path << std::endl;
+                stage_done("cache");
+            }
+        }
+        auto next = std::make_unique<FrozenHashMapImpl>();
+        const bool mapped = next->Map(path, bopt);
+        if (adopt_fd >= 0 && !adopt_memfd) ::close(adopt_fd);   // 映射已持有文件
+        if (!mapped) return fail("map");
+        LOG_INFO << "[load] " << target << " backend=" << next->BackendName()
+                 << " storage=" << next->Backend()->Access().name() << std::endl;
+        stage_done("map");
+        if (!next->Validate()) return fail("validate");
+        if (want.version >= 2) {
+            std::string why;
+            if (!next->MatchesManifest(want, &why)) {
+                LOG_ERROR << "[load] " << target << " generation=" << want.generation << " " << why << std::endl;
+                return fail("validate");
+            }
+        }
+        stage_done("validate");
+
+        PrefetchOptions wopt = opt_.prefetch;
+        PrefetchStats pstats;
+        int last_decile = -1;
+        wopt.progress = [&](uint64_t done, uint64_t total) {
+            int decile = int(done * 10 / std::max<uint64_t>(total, 1));
+            if (decile == last_decile) return;
+            last_decile = decile;
+            double sec = std::chrono::duration<double>(clock::now() - t_stage).count();
+            LOG_INFO << "[load] " << target << " stage=prefetch progress=" << decile * 10 << "%"
+                     << " rate=" << (sec > 0 ? done / sec / (1 << 20) : 0) << "MiB/s" << std::endl;
+        };
+        // 超预算的文件映射只预热预算计划 (索引段 + value 前缀), promote 阈值也按计划计算
+        const bool budgeted = opt_.residency_budget && next->Backend()->Evictable() &&
+                              next->MappedSize() > opt_.residency_budget;
+        std::vector<ByteRange> plan;
+        if (budgeted) {
+            plan = next->BudgetPlan(opt_.residency_budget);
+            LOG_INFO << "[load] " << target << " size " << next->MappedSize() << " exceeds budget "
+                     << opt_.residency_budget << ", warm index sections + value prefix only" << std::endl;
+        }
+        if (opt_.residency_budget) next->EnableHeatSampling();
+
+        // 分块校验: 首轮预热按校验单元领取, 缺页 / 读入后由同一线程比对 hash, 不另起全量校验遍
+        std::vector<VerifyUnit> sums;
+        const bool trusted = adopt_fd >= 0 || next->Backend()->Verified();
+        if (opt_.verify_segments && trusted) {
+            LOG_INFO << "[load] " << target << " verify=inherited from "
+                     << (adopt_fd >= 0 ? "previous process" : "loader") << std::endl;
+        } else if (opt_.verify_segments) {
+            const char* source = "";
+            SumState st = next->ChecksumUnits(&sums, &source);
+            if (st == SumState::kCorrupt) {
+                Metrics::Instance().Set("frozen_verify_failures", double(++verify_failures_));
+                return fail("verify");
+            }
+            if (st == SumState::kNone) {
+                LOG_INFO << "[load] " << target << " has no segment checksums, loading unverified" << std::endl;
+            } else {
+                if (budgeted) {
+                    // 只校验预算计划覆盖到的单元
+                    sums.erase(std::remove_if(sums.begin(), sums.end(), [&](const VerifyUnit& u) {
+                        return std::none_of(plan.begin(), plan.end(), [&](const ByteRange& r) {
+                            return u.off < r.first + r.second && r.first < u.off + u.len + u.extra;
+                        });
+                    }), sums.end());
+                }
+                wopt.verify = &sums;
+                LOG_INFO << "[load] " << target << " verify=" << source << " units=" << sums.size() << std::endl;
+            }
+        }
+        bool verified = trusted;   // 整表内容已校验 (分块全覆盖 / 全量 checksum / 继承), 决定交出时的标记
+        double residency = 0;
+        for (int round = 0; round < std::max(1, opt_.warm_rounds); ++round) {
+            last_decile = -1;
+            bool warmed = budgeted ? next->WarmRanges(plan, wopt, &cancel_, &pstats)
+                                   : next->Warm(wopt, &cancel_, &pstats);
+            if (!warmed && pstats.corrupt) {
+                Metrics::Instance().Set("frozen_verify_failures", double(++verify_failures_));
+                return fail("verify");
+            }
+            if (!warmed) {
+                if (!cancel_) return fail("prefetch");
+                LOG_INFO << "[load] " << target << " cancelled" << std::endl;
+                busy_ = false;
+                return;
+            }
+            LOG_INFO << "[load] " << target << " stage=prefetch round=" << round + 1
+                     << " bytes=" << pstats.bytes << " threads=" << wopt.threads
+                     << " chunk=" << (wopt.chunk_bytes >> 20) << "MiB"
+                     << " populate_read=" << pstats.populate_read
+                     << " throughput=" << pstats.GiBps() << "GiB/s"
+                     << (wopt.verify ? " verified=" + std::to_string(pstats.verified) : std::string()) << std::endl;
+            if (wopt.verify) Metrics::Instance().Set("frozen_verified_bytes", double(pstats.verified));
+            if (wopt.verify && !budgeted) verified = true;
+            wopt.verify = nullptr;   // 之后的轮次只补缺页
+            residency = budgeted ? next->Residency(plan) : next->Residency();
+            if (residency >= opt_.promote_residency) break;
+        }
+        {
+            std::ostringstream oss;
+            for (const auto& r : next->SectionResidencies()) oss << " " << r.name << "=" << r.Ratio() * 100 << "%";
+            LOG_INFO << "[load] " << target << " residency" << oss.str() << std::endl;
+        }
+        Metrics::Instance().Set("frozen_prefetch_bytes", double(pstats.bytes));
+        Metrics::Instance().Set("frozen_prefetch_gibps", pstats.GiBps());
+        stage_done("prefetch");
+        if (opt_.backend.huge_pages != HugePageMode::kOff) {
+            const LoadBackend* be = next->Backend();
+            uint64_t want = (next->MappedSize() + kHugePage - 1) / kHugePage;
+            LOG_INFO << "[load] " << target << " huge_pages=" << be->HugePages() << "/" << want
+                     << " mode=" << HugePageModeName(be->HugeMode())
+                     << " requested=" << HugePageModeName(opt_.backend.huge_pages) << std::endl;
+        }
+        if (residency < opt_.promote_residency) {
+            LOG_ERROR << "[load] " << target << " residency " << residency * 100
+                      << "% below threshold " << opt_.promote_residency * 100 << "%" << std::endl;
+            return fail("promote");
+        }
+        if (opt_.verify_checksum && want.has_checksum && !trusted) {
+            uint64_t got = next->ContentHash();
+            if (got != want.checksum) {
+                LOG_ERROR << "[load] " << target << " checksum " << std::hex << got
+                          << " != manifest " << want.checksum << std::dec << std::endl;
+                return fail("verify");
+            }
+            verified = true;
+            stage_done("verify");
+        }
+
+        if (share) hub_->Publish(key, next->Backend()->ShareFd(), verified);
+        SPD_LOG_INFO(" {} success", next->ModelsDesc());
+        snapshot_.Publish(std::move(next));
+        stage_done("promote");
+        double total_s = std::chrono::duration<double>(clock::now() - t_begin).count();
+        LOG_INFO << "[load] " << target << " promoted residency=" << residency * 100 << "%"
+                 << " total=" << total_s << "s" << std::endl;
+        Metrics::Instance().Set("frozen_load_seconds", total_s);
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            loaded_ = true;
+            loaded_info_ = want;
+            loaded_mtime_ = mtime;
+            busy_ = false;
+        }
+    }
+
+    TableSnapshot& snapshot_;
+    StagedLoadOptions opt_;
+    LocalCache* cache_;
+    ShareHub* hub_;
+    int adopt_fd_{-1};
+    bool adopt_memfd_{false};
+    std::thread worker_;
+    std::atomic<bool> cancel_{false};
+    std::atomic<bool> busy_{false};
+    std::mutex mu_;
+    bool loaded_{false};
+    ManifestInfo loaded_info_;
+    time_t loaded_mtime_{0};
+    uint64_t verify_failures_{0};
+};
+
+// === 内存预算常驻管理 ===
+// 每个 watch 周期: 索引段 (models/buckets/entries) 保持常驻; value_pool 按 2 MiB 分区
+// 的采样热度 (指数衰减) 排序, 取热区间填满剩余预算并预热, 其余已常驻区间换出:
+// 总常驻未超预算时 MADV_COLD (软), 超预算时 MADV_PAGEOUT + FADV_DONTNEED (硬).
+// 仅对 mmap 后端生效; 匿名缓冲后端本身就是整表常驻.
+class ResidencyManager {
+public:
+    ResidencyManager(uint64_t budget, const PrefetchOptions& prefetch)
+        : budget_(budget), prefetch_(prefetch) {}
+
+    void Tick(const TableSnapshot& snapshot) {
+        if (!budget_) return;
+        auto t = snapshot.Acquire();
+        if (!t) return;
+        if (!t->Backend()->Evictable()) {
+            if (!warned_) LOG_INFO << "[residency] backend " << t->BackendName() << " not evictable, budget ignored" << std::endl;
+            warned_ = true;
+            return;
+        }
+        if (t.get() != table_) {
+            table_ = t.get();
+            score_.clear();
+        }
+        std::vector<uint32_t> heat = t->DrainHeat();
+        score_.resize(heat.size(), 0.0);
+        for (size_t i = 0; i < heat.size(); ++i) score_[i] = score_[i] * 0.5 + heat[i];
+
+        const uint64_t pool_off = t->ValuePoolOffset();
+        const uint64_t pool_sz = t->ValuePoolSize();
+        uint64_t left = budget_ > pool_off ? budget_ - pool_off : 0;
+        if (!left) LOG_ERROR << "[residency] index sections " << pool_off << " exceed budget " << budget_ << std::endl;
+
+        std::vector<size_t> order(score_.size());
+        for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return score_[a] > score_[b]; });
+        std::vector<bool> keep(score_.size(), false);
+        for (size_t i : order) {
+            uint64_t len = std::min(FrozenHashMapImpl::kHeatRange, pool_sz - i * FrozenHashMapImpl::kHeatRange);
+            if (score_[i] <= 0 || len > left) break;
+            keep[i] = true;
+            left -= len;
+        }
+
+        // 先预热缺页的热区间, 再按扫描结果换出冷区间 (预热的 readahead 可能带入相邻冷页)
+        ResidencyTracker tracker;
+        const char* base = t->Backend()->data();
+        if (!tracker.Scan(base, t->MappedSize())) return;
+        std::vector<ByteRange> warm;
+        auto idx = tracker.Section(TableSection{"", 0, pool_off});
+        if (idx.resident < idx.pages) warm.emplace_back(0, pool_off);
+        for (size_t i = 0; i < keep.size(); ++i) {
+            uint64_t off = pool_off + i * FrozenHashMapImpl::kHeatRange;
+            uint64_t len = std::min(FrozenHashMapImpl::kHeatRange, pool_sz - i * FrozenHashMapImpl::kHeatRange);
+            auto r = tracker.Section(TableSection{"", off, len});
+            if (keep[i] && r.resident < r.pages) warm.emplace_back(off, len);
+        }
+        PrefetchStats stats;
+        if (!warm.empty()) {
+            t->WarmRanges(warm, prefetch_, nullptr, &stats);
+            tracker.Scan(base, t->MappedSize());
+        }
+        const uint64_t resident = tracker.Total().resident * ResidencyTracker::kPage;
+        const bool over = resident > budget_;
+        uint64_t evicted = 0;
+        for (size_t i = 0; i < keep.size(); ++i) {
+            if (keep[i]) continue;
+            uint64_t off = pool_off + i * FrozenHashMapImpl::kHeatRange;
+            uint64_t len = std::min(FrozenHashMapImpl::kHeatRange, pool_sz - i * FrozenHashMapImpl::kHeatRange);
+            auto r = tracker.Section(TableSection{"", off, len});
+            if (!r.resident) continue;
+            // 分区首尾页可能与热分区共享, 只换出完整页
+            uint64_t a = (off + 4095) & ~4095ull, z = (off + len) & ~4095ull;
+            if (z > a) t->Backend()->Evict(a, z - a, over);
+            evicted += r.resident * ResidencyTracker::kPage;
+        }
+        Metrics::Instance().Set("frozen_residency_budget_bytes", double(budget_));
+        Metrics::Instance().Set("frozen_resident_bytes", double(resident));
+        if (evicted || !warm.empty())
+            LOG_INFO << "[residency] resident=" << resident << " budget=" << budget_
+                     << " hot_ranges=" << std::count(keep.begin(), keep.end(), true)
+                     << " warmed=" << stats.bytes
+                     << " evicted=" << evicted << (over ? " (pageout)" : " (cold)") << std::endl;
+    }
+
+private:
+    uint64_t budget_;
+    PrefetchOptions prefetch_;
+    const FrozenHashMapImpl* table_{nullptr};
+    std::vector<double> score_;
+    bool warned_{false};
+};
+
+// === 工具函数 ===
+static std::string GetEnvOrDefault(const char* k, const std::string& defv) {
+    const char* v = std::getenv(k);
+    return (v && *v) ? std::string(v) : defv;
+}
+static bool FileExistsNonEmpty(const std::string& path) {
+    struct stat st{};
+    return stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0;
+}
+static bool AtomicWriteFile(const std::string& path, const std::string& content) {
+    std::string tmp = path + ".tmp";
+    std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+    if (!ofs) return false;
+    ofs.write(content.data(), content.size());
+    ofs.close();
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+static std::string FormatManifest(const ManifestInfo& m) {
+    std::ostringstream oss;
+    oss << "manifest_version=2\n"
+        << "generation=" << m.generation << "\n"
+        << "target=" << m.target << "\n"
+        << "size=" << m.size << "\n";
+    if (m.has_checksum) {
+        char hex[17];
+        std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(m.checksum));
+        oss << "checksum=xxh64:" << hex << "\n";
+    }
+    if (!m.sections.empty()) {
+        oss << "sections=";
+        for (size_t i = 0; i < m.sections.size(); ++i)
+            oss << (i ? "," : "") << m.sections[i].first << ":" << m.sections[i].second.first
+                << "+" << m.sections[i].second.second;
+        oss << "\n";
+    }
+    oss << "published_at_ns=" << m.published_at_ns << "\n";
+    return oss.str();
+}
+
+static bool WriteManifest(const std::string& manifest_path, const ManifestInfo& m) {
+    return AtomicWriteFile(manifest_path, FormatManifest(m));
+}
+
+// sections=name:off+len,...
+static bool ParseManifestSections(const std::string& v, ManifestInfo* m) {
+    std::istringstream iss(v);
+    std::string item;
+    while (std::getline(iss, item, ',')) {
+        size_t colon = item.find(':'), plus = item.find('+');
+        if (colon == std::string::npos || plus == std::string::npos || plus < colon) return false;
+        m->sections.emplace_back(item.substr(0, colon),
+                                 ByteRange{std::strtoull(item.c_str() + colon + 1, nullptr, 10),
+                                           std::strtoull(item.c_str() + plus + 1, nullptr, 10)});
+    }
+    return true;
+}
+
+static bool ParseManifest(std::istream& in, ManifestInfo* out) {
+    ManifestInfo m;
+    std::string line;
+    bool any = false;
+    while (std::getline(in, line)) {
+        size_t a = line.find_first_not_of(" \t\r\n");
+        if (a == std::string::npos) continue;
+        size_t b = line.find_last_not_of(" \t\r\n");
+        line = line.substr(a, b - a + 1);
+        size_t eq = line.find('=');
+        if (!any && (eq == std::string::npos || line.compare(0, eq, "manifest_version") != 0)) {
+            m.target = line;   // v1: 首个非空行即目标路径
+            *out = m;
+            return true;
+        }
+        any = true;
+        if (eq == std::string::npos) continue;
+        std::string k = line.substr(0, eq), v = line.substr(eq + 1);
+        if (k == "manifest_version") m.version = std::atoi(v.c_str());
+        else if (k == "generation") m.generation = std::strtoull(v.c_str(), nullptr, 10);
+        else if (k == "target") m.target = v;
+        else if (k == "size") m.size = std::strtoull(v.c_str(), nullptr, 10);
+        else if (k == "checksum" && v.compare(0, 6, "xxh64:") == 0) {
+            m.checksum = std::strtoull(v.c_str() + 6, nullptr, 16);
+            m.has_checksum = true;
+        } else if (k == "sections" && !ParseManifestSections(v, &m)) {
+            LOG_ERROR << "bad manifest sections: " << v << std::endl;
+            return false;
+        } else if (k == "published_at_ns") m.published_at_ns = std::strtoull(v.c_str(), nullptr, 10);
+    }
+    if (!any || m.target.empty()) return false;
+    *out = m;
+    return true;
+}
+
+static bool ReadManifest(const std::string& manifest_path, ManifestInfo* out) {
+    std::ifstream ifs(manifest_path);
+    return ifs && ParseManifest(ifs, out);
+}
+
+// === 流式写文件 (双缓冲) ===
+// 生产者按 block_bytes 生成内容并顺带算 XXH64, 写线程经 FileAccess pwrite 落盘, 两块缓冲交替,
+// 生成与 I/O 重叠. 写到 <path>.tmp, 结束时 fsync + rename + fsync 目录, reader 永远
+// 看不到半成品. direct=true 尝试 O_DIRECT (FUSE/tmpfs 不支持时自动退回 page cache).
+struct StreamWriteOptions {
+    uint64_t block_bytes = 8ULL << 20;
+    bool direct = false;
+    uint64_t sum_chunk = kSumChunk;   // 普通版本文件末尾 STRATSUM 校验尾的块大小, 0 = 不写
+};
+
+struct StreamWriteStats {
+    uint64_t bytes = 0;
+    double seconds = 0;
+    bool direct = false;
+    double GiBps() const { return seconds > 0 ? bytes / seconds / (1ULL << 30) : 0; }
+};
+
+class StreamingWriter {
+public:
+    using FillFn = std::function<void(uint64_t off, char* buf, std::size_t n)>;
+
+    explicit StreamingWriter(const StreamWriteOptions& opt) : opt_(opt) {
+        opt_.block_bytes = std::max<uint64_t>(kAlign, (opt_.block_bytes + kAlign - 1) / kAlign * kAlign);
+    }
+
+    bool Write(const std::string& path, uint64_t total, const FillFn& fill,
+               uint64_t* hash, StreamWriteStats* stats) {
+        auto t0 = std::chrono::steady_clock::now();
+        const std::string tmp = path + ".tmp";
+        bool direct = opt_.direct;
+        int fd = ::open(tmp.c_str(), O_CREAT | O_WRONLY | O_TRUNC | O_CLOEXEC | (direct ? O_DIRECT : 0), 0644);
+        if (fd < 0 && direct) {
+            LOG_INFO << "[write] O_DIRECT unsupported on " << tmp << " (" << std::strerror(errno)
+                     << "), using page cache" << std::endl;
+            direct = false;
+            fd = ::open(tmp.c_str(), O_CREAT | O_WRONLY | O_TRUNC | O_CLOEXEC, 0644);
+        }
+        if (fd < 0) {
+            LOG_ERROR << "open fail: " << tmp << " err=" << std::strerror(errno) << std::endl;
+            return false;
+        }
+        // 预分配避免稀疏 extent; 不支持的文件系统 (部分 FUSE) 忽略
+        if (posix_fallocate(fd, 0, (off_t)total) != 0)
+            LOG_INFO << "[write] posix_fallocate unsupported: " << tmp << std::endl;
+
+        Slot slots[2];
+        for (auto& s : slots) {
+            if (posix_memalign(reinterpret_cast<void**>(&s.buf), kAlign, opt_.block_bytes) != 0) s.buf = nullptr;
+        }
+        bool ok = slots[0].buf && slots[1].buf;
+        if (ok) ok = Pipeline(fd, FileAccess::For(path), total, direct, fill, slots, hash);
+        for (auto& s : slots) std::free(s.buf);
+
+        // O_DIRECT 末块按对齐补零写出, 这里截回真实长度
+        if (ok && direct && total % kAlign) ok = ftruncate(fd, (off_t)total) == 0;
+        if (ok && fsync(fd) != 0) {
+            LOG_ERROR << "fsync fail: " << tmp << " err=" << std::strerror(errno) << std::endl;
+            ok = false;
+        }
+        ::close(fd);
+        if (ok && std::rename(tmp.c_str(), path.c_str()) != 0) {
+            LOG_ERROR << "rename fail: " << tmp << " err=" << std::strerror(errno) << std::endl;
+            ok = false;
+        }
+        if (!ok) {
+            std::remove(tmp.c_str());
+            return false;
+        }
+        SyncParentDir(path);
+        if (stats) {
+            stats->bytes = total;
+            stats->direct = direct;
+            stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        }
+        return true;
+    }
+
+private:
+    static constexpr uint64_t kAlign = 4096;
+
+    struct Slot {
+        char* buf = nullptr;
+        uint64_t off = 0;
+        std::size_t len = 0;     // 有效字节
+        std::size_t io_len = 0;  // 实际写出 (O_DIRECT 对齐后)
+        bool full = false;
+    };
+
+    bool Pipeline(int fd, const FileAccess& access, uint64_t total, bool direct, const FillFn& fill, Slot* slots,
+                  uint64_t* hash) {
+        std::mutex mu;
+        std::condition_variable cv;
+        bool done = false;
+        std::atomic<bool> failed{false};
+
+        std::thread io([&] {
+            for (uint64_t k = 0;; ++k) {
+                Slot& s = slots[k & 1];
+                {
+                    std::unique_lock<std::mutex> lk(mu);
+                    cv.wait(lk, [&] { return s.full || done; });
+                    if (!s.full) return;
+                }
+                std::size_t put = 0;
+                while (put < s.io_len && !failed) {
+                    ssize_t n = access.Pwrite(fd, s.buf + put, s.io_len - put, s.off + put);
+                    if (n < 0 && errno == EINTR) continue;
+                    if (n <= 0) {
+                        LOG_ERROR << "pwrite fail off=" << s.off + put << " err=" << std::strerror(errno) << std::endl;
+                        failed = true;
+                        break;
+                    }
+                    put += (std::size_t)n;
+                }
+                {
+                    std::lock_guard<std::mutex> lk(mu);
+                    s.full = false;
+                }
+                cv.notify_all();
+            }
+        });
+
+        Xxh64 h;
+        for (uint64_t off = 0, k = 0; off < total && !failed; off += opt_.block_bytes, ++k) {
+            Slot& s = slots[k & 1];
+            {
+                std::unique_lock<std::mutex> lk(mu);
+                cv.wait(lk, [&] { return !s.full; });
+            }
+            s.off = off;
+            s.len = (std::size_t)std::min<uint64_t>(opt_.block_bytes, total - off);
+            s.io_len = s.len;
+            fill(off, s.buf, s.len);
+            h.Update(s.buf, s.len);
+            if (direct && s.len % kAlign) {
+                s.io_len = (s.len + kAlign - 1) / kAlign * kAlign;
+                std::memset(s.buf + s.len, 0, s.io_len - s.len);
+            }
+            {
+                std::lock_guard<std::mutex> lk(mu);
+                s.full = true;
+            }
+            cv.notify_all();
+        }
+        {
+            std::lock_guard<std::mutex> lk(mu);
+            done = true;
+        }
+        cv.notify_all();
+        io.join();
+        if (hash) *hash = h.Digest();
+        return !failed;
+    }
+
+    static void SyncParentDir(const std::string& path) {
+        size_t slash = path.find_last_of('/');
+        std::string dir = slash == std::string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+        int dfd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dfd < 0) return;
+        fsync(dfd);
+        ::close(dfd);
+    }
+
+    StreamWriteOptions opt_;
+};
+
+// === Delta 版本 (分段容器写出) ===
+// 逻辑内容按 segment_bytes 切段并逐段 XXH64; 与参照版本 (上一个容器) 同位置同 hash 的段
+// 直接引用其所在文件, 只有变化段写进新容器. 引用文件数超过 max_files 时写全量容器 (压实),
+// 避免引用链无限增长. 参照不是容器 (普通文件 / 首个版本) 时同样写全量容器.
+struct DeltaOptions {
+    uint64_t segment_bytes = 0;   // 0 = 写普通文件
+    std::string base;             // 参照版本路径
+    uint32_t max_files = 8;
+};
+
+static std::string BaseName(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+static bool WriteSegmentedVersion(const std::string& path, uint64_t total, const StreamingWriter::FillFn& fill,
+                                  const DeltaOptions& delta, const StreamWriteOptions& wopt,
+                                  uint64_t* hash, StreamWriteStats* stats) {
+    const uint64_t seg = std::max(kSegAlign, (delta.segment_bytes + kSegAlign - 1) / kSegAlign * kSegAlign);
+    SegmentTable prev;
+    bool have_prev = !delta.base.empty() && IsSegmentedFile(delta.base) && ReadSegmentTable(delta.base, &prev);
+
+    // 第一遍: 生成 + 分段 hash, 决定复用
+    std::vector<SegmentRef> segs;
+    std::vector<std::string> ref_paths;     // 每段来源, 空 = 本文件
+    std::vector<char> buf(seg);
+    Xxh64 whole;
+    for (uint64_t off = 0; off < total; off += seg) {
+        SegmentRef s{};
+        s.logical_off = off;
+        s.len = std::min(seg, total - off);
+        fill(off, buf.data(), s.len);
+        whole.Update(buf.data(), s.len);
+        s.hash = Xxh64::Hash(buf.data(), s.len);
+        std::string from;
+        size_t i = segs.size();
+        if (have_prev && i < prev.segs.size() && prev.segs[i].logical_off == off && prev.segs[i].len == s.len &&
+            prev.segs[i].hash == s.hash) {
+            from = prev.files[prev.segs[i].file_idx];
+            s.file_off = prev.segs[i].file_off;
+        }
+        segs.push_back(s);
+        ref_paths.push_back(from);
+    }
+    std::vector<std::string> names{BaseName(path)};
+    std::map<std::string, uint32_t> file_idx;
+    for (const auto& p : ref_paths)
+        if (!p.empty() && !file_idx.count(p)) file_idx.emplace(p, 0);
+    if (file_idx.size() + 1 > delta.max_files) {
+        LOG_INFO << "[delta] " << path << " references " << file_idx.size() << " files, compact to full" << std::endl;
+        file_idx.clear();
+        std::fill(ref_paths.begin(), ref_paths.end(), std::string());
+    }
+    for (auto& kv : file_idx) {
+        if (DirOf(kv.first) != DirOf(path)) {
+            LOG_ERROR << "[delta] base segment file outside " << DirOf(path) << ": " << kv.first << std::endl;
+            return false;
+        }
+        kv.second = (uint32_t)names.size();
+        names.push_back(BaseName(kv.first));
+    }
+
+    // 布局: 元数据 + 本文件段 (各自 4 KiB 对齐)
+    SegFileHeader h{};
+    std::memcpy(h.magic, "STRATSEG", 8);
+    h.version = 1;
+    h.file_cnt = (uint32_t)names.size();
+    h.seg_cnt = segs.size();
+    h.logical_size = total;
+    uint64_t meta = sizeof(h) + names.size() * sizeof(SegFileRef) + segs.size() * sizeof(SegmentRef);
+    h.data_off = (meta + kSegAlign - 1) / kSegAlign * kSegAlign;
+    struct Piece { uint64_t off, len, logical_off; };
+    std::vector<Piece> pieces;
+    uint64_t cursor = h.data_off, reused = 0;
+    for (size_t i = 0; i < segs.size(); ++i) {
+        if (!ref_paths[i].empty()) {
+            segs[i].file_idx = file_idx[ref_paths[i]];
+            reused += segs[i].len;
+            continue;
+        }
+        segs[i].file_idx = 0;
+        segs[i].file_off = cursor;
+        pieces.push_back(Piece{cursor, segs[i].len, segs[i].logical_off});
+        cursor += (segs[i].len + kSegAlign - 1) / kSegAlign * kSegAlign;
+    }
+    const uint64_t file_size = pieces.empty() ? h.data_off : pieces.back().off + pieces.back().len;
+    std::vector<char> head(meta, 0);
+    std::memcpy(head.data(), &h, sizeof(h));
+    for (size_t i = 0; i < names.size(); ++i) {
+        SegFileRef r{};
+        std::strncpy(r.name, names[i].c_str(), sizeof(r.name) - 1);
+        std::memcpy(head.data() + sizeof(h) + i * sizeof(SegFileRef), &r, sizeof(r));
+    }
+    std::memcpy(head.data() + sizeof(h) + names.size() * sizeof(SegFileRef), segs.data(), segs.size() * sizeof(SegmentRef));
+
+    // 第二遍: 流式写容器, 变化段重新生成
+    auto cfill = [&](uint64_t off, char* out, std::size_t n) {
+        std::memset(out, 0, n);
+        if (off < head.size()) std::memcpy(out, head.data() + off, std::min<uint64_t>(n, head.size() - off));
+        for (const auto& p : pieces) {
+            uint64_t a = std::max(off, p.off), b = std::min(off + n, p.off + p.len);
+            if (a < b) fill(p.logical_off + (a - p.off), out + (a - off), b - a);
+        }
+    };
+    if (!StreamingWriter(wopt).Write(path, file_size, cfill, nullptr, stats)) return false;
+    *hash = whole.Digest();
+    LOG_INFO << "[delta] " << path << " segments=" << segs.size() << " reused=" << reused << "/" << total
+             << " bytes written=" << file_size << " files=" << names.size() << std::endl;
+    return true;
+}
+
+// === 生成大模型文件（简单 Header + 填充）===
+// 以流式写出 header + model + 全零 value pool, 不再 mmap + memset + MS_SYNC.
+// delta.segment_bytes 非 0 时写分段容器, 复用参照版本中未变化的段.
+static bool GenerateBigModelFile(const std::string& path,
+                                 uint64_t total_bytes,
+                                 uint32_t model_id = 1,
+                                 uint32_t model_version = 1,
+                                 ManifestInfo* info = nullptr,
+                                 const StreamWriteOptions& wopt = StreamWriteOptions{},
+                                 const DeltaOptions& delta = DeltaOptions{}) {
+    if (total_bytes < sizeof(FrozenHeader) + sizeof(Model)) {
+        LOG_ERROR << "size too small: " << total_bytes << std::endl;
+        return false;
+    }
+    // value pool 超出 v1 的 32 位上限时写 v2 header, 不再截断
+    const bool v2 = total_bytes - sizeof(FrozenHeader) - sizeof(Model) > UINT32_MAX;
+    const uint64_t hdr_len = v2 ? sizeof(FrozenHeaderV2) : sizeof(FrozenHeader);
+    FrozenHeader hdr{};
+    FrozenHeaderV2 hdr2{};
+    std::memcpy(hdr.magic, "STRATEGY", 8);
+    hdr.version = 1;
+    hdr.model_cnt = 1;
+    hdr.val_pool_sz = (uint32_t)std::min<uint64_t>(UINT32_MAX, total_bytes - hdr_len - sizeof(Model));
+    std::memcpy(hdr2.magic, "STRATEGY", 8);
+    hdr2.version = 2;
+    hdr2.model_cnt = 1;
+    hdr2.val_pool_sz = total_bytes - hdr_len - sizeof(Model);
+    char prefix[sizeof(FrozenHeaderV2) + sizeof(Model)];
+    if (v2) std::memcpy(prefix, &hdr2, sizeof(hdr2));
+    else std::memcpy(prefix, &hdr, sizeof(hdr));
+    Model m{model_id, model_version};
+    std::memcpy(prefix + hdr_len, &m, sizeof(Model));
+    const uint64_t prefix_len = hdr_len + sizeof(Model);
+
+    auto fill = [&](uint64_t off, char* buf, std::size_t n) {
+        std::memset(buf, 0, n);
+        if (off < prefix_len)
+            std::memcpy(buf, prefix + off, std::min<uint64_t>(n, prefix_len - off));
+    };
+    StreamWriteStats st;
+    uint64_t hash = 0;
+    // 普通文件追加分块校验尾 (分段容器的段表已带 hash); manifest 的 size / checksum 覆盖整个文件
+    SumTrailerWriter sums(total_bytes, wopt.sum_chunk);
+    const uint64_t file_size = delta.segment_bytes || !wopt.sum_chunk ? total_bytes : sums.FileSize();
+    auto sfill = [&](uint64_t off, char* buf, std::size_t n) { sums.Fill(fill, off, buf, n); };
+    bool ok = delta.segment_bytes  ? WriteSegmentedVersion(path, total_bytes, fill, delta, wopt, &hash, &st)
+              : wopt.sum_chunk     ? StreamingWriter(wopt).Write(path, file_size, sfill, &hash, &st)
+                                   : StreamingWriter(wopt).Write(path, total_bytes, fill, &hash, &st);
+    if (!ok) {
+        LOG_ERROR << "write fail: " << path << std::endl;
+        return false;
+    }
+    if (info) {
+        info->target = path;
+        info->size = file_size;
+        info->checksum = hash;
+        info->has_checksum = true;
+        info->sections.clear();
+        for (const auto& sec : v2 ? LayoutSections(hdr2) : LayoutSections(hdr))
+            info->sections.emplace_back(sec.name, ByteRange{sec.offset, sec.len});
+    }
+    LOG_INFO << "Generated model file: " << path
+             << " size=" << file_size
+             << " model=" << model_id << ":" << model_version
+             << " cost=" << st.seconds << "s throughput=" << st.GiBps() << "GiB/s"
+             << " direct=" << st.direct << std::endl;
+    return true;
+}
+
+// === 离线构建: key\tvalue 记录 -> STRATEGY 冻结表 ===
+// 输入按行切成 BUILD_THREADS 段并行流式解析, 共三遍扫描:
+//   1) 统计记录数与 value 字节数 -> 确定 bucket_cnt (2 的幂) 与文件大小;
+//   2) 直接在输出文件映射的 bucket 区做原子计数, 再原地前缀和;
+//   3) value 顺序写入各段自己的 val_pool 区间, Entry 按桶游标落位.
+// 最后桶内按 (key_hash, value_offset) 排序保证输出确定, 重复 key 先出现者生效.
+// 进程内存只有读缓冲; 输出区写满一个窗口即 MADV_DONTNEED 交给 page cache 回写.
+static uint32_t DefaultThreads(const char* env) {
+    int n = std::atoi(GetEnvOrDefault(env, "0").c_str());
+    if (n <= 0) n = (int)std::thread::hardware_concurrency();
+    return (uint32_t)std::max(1, n);
+}
+
+// 把 pos 推进到下一行行首 (pos == 0 不动)
+static uint64_t AlignToLine(int fd, uint64_t pos, uint64_t fsize) {
+    if (pos == 0 || pos >= fsize) return std::min(pos, fsize);
+    char buf[4096];
+    uint64_t off = pos - 1;
+    while (off < fsize) {
+        ssize_t n = ::pread(fd, buf, sizeof(buf), (off_t)off);
+        if (n <= 0) return fsize;
+        const void* nl = std::memchr(buf, '\n', (size_t)n);
+        if (nl) return off + (static_cast<const char*>(nl) - buf) + 1;
+        off += n;
+    }
+    return fsize;
+}
+
+// 流式读取 [begin, end) 的每条记录, fn(key, value); 没有 \t 的行计入 malformed 跳过.
+template <typename Fn>
+static bool ForEachRecord(int fd, uint64_t begin, uint64_t end, uint64_t* malformed, Fn&& fn) {
+    static const size_t kBlock = 4 << 20;
+    std::vector<char> block(kBlock);
+    std::string carry;
+    auto on_line = [&](std::string_view line) {
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        if (line.empty()) return;
+        size_t tab = line.find('\t');
+        if (tab == std::string_view::npos) { ++*malformed; return; }
+        fn(line.substr(0, tab), line.substr(tab + 1));
+    };
+    for (uint64_t off = begin; off < end;) {
+        ssize_t n = ::pread(fd, block.data(), std::min<uint64_t>(kBlock, end - off), (off_t)off);
+        if (n <= 0) return false;
+        off += n;
+        const char* p = block.data();
+        const char* e = p + n;
+        while (p < e) {
+            const char* nl = static_cast<const char*>(std::memchr(p, '\n', e - p));
+            if (!nl) { carry.append(p, e); break; }
+            if (carry.empty()) {
+                on_line(std::string_view(p, nl - p));
+            } else {
+                carry.append(p, nl);
+                on_line(carry);
+                carry.clear();
+            }
+            p = nl + 1;
+        }
+    }
+    if (!carry.empty()) on_line(carry);
+    return true;
+}
+
+// 构建输出: 单文件, 或按 split_bytes 切成 <out>.part<k>, 由 STRATSEG 容器 <out> 拼成一张逻辑表.
+// 分片时预留连续地址, 各分片 MAP_FIXED 映射进去, 构建代码仍按一块连续内存写.
+// 单文件输出在表后追加 STRATSUM 校验尾 (sum_chunk 非 0), 分片输出的校验和在容器段表里.
+class TableOutput {
+public:
+    ~TableOutput() { Abort(); }
+
+    bool Create(const std::string& output, uint64_t total, uint64_t split, uint64_t sum_chunk) {
+        output_ = output;
+        total_ = total;
+        split_ = split ? std::max(kSegAlign, split / kSegAlign * kSegAlign) : 0;
+        if (!split_ || total <= split_) split_ = 0;
+        sum_chunk_ = split_ ? 0 : sum_chunk;
+        total += SumTrailerBytes(total_, sum_chunk_);
+        uint64_t reserve = (total + kSegAlign - 1) / kSegAlign * kSegAlign;
+        void* p = ::mmap(nullptr, reserve, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (p == MAP_FAILED) {
+            LOG_ERROR << "reserve output fail: " << total << " err=" << strerror(errno) << std::endl;
+            return false;
+        }
+        base_ = static_cast<char*>(p);
+        reserve_ = reserve;
+        const uint64_t part = split_ ? split_ : total;
+        for (uint64_t off = 0; off < total; off += part) {
+            std::string path = split_ ? output + ".part" + std::to_string(parts_.size()) : output;
+            Part pt{path, off, std::min(part, total - off), -1};
+            pt.fd = ::open((path + ".tmp").c_str(), O_CREAT | O_RDWR | O_TRUNC | O_CLOEXEC, 0644);
+            parts_.push_back(pt);
+            if (pt.fd < 0 || ::ftruncate(pt.fd, (off_t)pt.len) != 0 ||
+                ::mmap(base_ + off, pt.len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, pt.fd, 0) == MAP_FAILED) {
+                LOG_ERROR << "create output fail: " << path << ".tmp err=" << strerror(errno) << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    char* data() const { return base_; }
+    size_t Parts() const { return parts_.size(); }
+
+    // 落盘并 rename; 分片时再写容器 (段 hash 并行计算)
+    bool Commit(uint32_t threads) {
+        std::vector<SegmentRef> segs(parts_.size());
+        if (split_) {
+            ParallelFor(std::min<uint32_t>(threads, (uint32_t)parts_.size()), [&](uint32_t t) {
+                for (size_t i = t; i < parts_.size(); i += std::min<uint32_t>(threads, (uint32_t)parts_.size())) {
+                    segs[i].logical_off = parts_[i].off;
+                    segs[i].len = parts_[i].len;
+                    segs[i].file_idx = (uint32_t)i + 1;
+                    segs[i].hash = Xxh64::Hash(base_ + parts_[i].off, parts_[i].len);
+                }
+            });
+        }
+        const uint64_t trailer = SumTrailerBytes(total_, sum_chunk_);
+        if (trailer) {
+            std::string t = BuildSumTrailer(base_, total_, sum_chunk_, threads);
+            std::memcpy(base_ + total_, t.data(), t.size());
+        }
+        bool ok = msync(base_, total_ + trailer, MS_SYNC) == 0;
+        ::munmap(base_, reserve_);
+        base_ = nullptr;
+        for (auto& pt : parts_) {
+            ok = ok && ::fsync(pt.fd) == 0;
+            ::close(pt.fd);
+            pt.fd = -1;
+            ok = ok && std::rename((pt.path + ".tmp").c_str(), pt.path.c_str()) == 0;
+        }
+        if (!ok) {
+            LOG_ERROR << "finalize output fail: " << output_ << " err=" << strerror(errno) << std::endl;
+            Abort();
+            return false;
+        }
+        if (split_) {
+            SegFileHeader h{};
+            std::memcpy(h.magic, "STRATSEG", 8);
+            h.version = 1;
+            h.file_cnt = (uint32_t)parts_.size() + 1;
+            h.seg_cnt = segs.size();
+            h.logical_size = total_;
+            std::string meta(sizeof(h) + h.file_cnt * sizeof(SegFileRef) + segs.size() * sizeof(SegmentRef), '\0');
+            h.data_off = meta.size();
+            std::memcpy(&meta[0], &h, sizeof(h));
+            for (uint32_t i = 0; i < h.file_cnt; ++i) {
+                SegFileRef r{};
+                std::strncpy(r.name, BaseName(i ? parts_[i - 1].path : output_).c_str(), sizeof(r.name) - 1);
+                std::memcpy(&meta[sizeof(h) + i * sizeof(SegFileRef)], &r, sizeof(r));
+            }
+            std::memcpy(&meta[sizeof(h) + h.file_cnt * sizeof(SegFileRef)], segs.data(), segs.size() * sizeof(SegmentRef));
+            auto fill = [&](uint64_t off, char* buf, std::size_t n) { std::memcpy(buf, meta.data() + off, n); };
+            if (!StreamingWriter(StreamWriteOptions{}).Write(output_, meta.size(), fill, nullptr, nullptr)) return false;
+        }
+        parts_.clear();
+        return true;
+    }
+
+    void Abort() {
+        if (base_) ::munmap(base_, reserve_);
+        base_ = nullptr;
+        for (auto& pt : parts_) {
+            if (pt.fd >= 0) ::close(pt.fd);
+            std::remove((pt.path + ".tmp").c_str());
+        }
+        parts_.clear();
+    }
+
+private:
+    struct Part {
+        std::string path;
+        uint64_t off;
+        uint64_t len;
+        int fd;
+    };
+    std::string output_;
+    uint64_t total_{0};          // 表本身 (不含校验尾)
+    uint64_t split_{0};
+    uint64_t sum_chunk_{0};
+    char* base_{nullptr};
+    uint64_t reserve_{0};
+    std::vector<Part> parts_;
+};
+
+// pass 1 的结果, 供按格式模板化的 pass 2/3 使用
+struct BuildPlan {
+    int in = -1;
+    uint32_t threads = 1;
+    std::vector<uint64_t> cut;
+    std::vector<uint64_t> val_base;
+    std::vector<uint64_t> key_base;   // swiss 需要, kv_pool 中段 t 起点 = val_base[t] + key_base[t]
+    uint64_t n_rec = 0;
+    uint64_t n_val = 0;
+    uint64_t n_key = 0;
+    uint64_t n_bad = 0;
+    uint64_t max_field = 0;           // 最长的 key / value
+    uint64_t sum_chunk = 0;           // 单文件输出的校验尾块大小
+};
+
+template <typename L>
+static bool BuildTableT(const BuildPlan& plan, const std::string& output, uint32_t model_id, uint32_t model_version,
+                        uint64_t split, uint64_t* out_total, size_t* out_parts, uint64_t* out_buckets,
+                        uint64_t* out_collisions) {
+    using Bucket = typename L::Bucket;
+    using Ent = typename L::Ent;
+    using Hash = decltype(Ent::key_hash);
+    const uint32_t threads = plan.threads;
+    const auto& cut = plan.cut;
+    const int in = plan.in;
+    const uint64_t n_rec = plan.n_rec;
+    uint64_t bucket_cnt = 1;
+    while (bucket_cnt < n_rec) bucket_cnt <<= 1;
+    const uint64_t mask = bucket_cnt - 1;
+
+    const uint64_t off_bucket = sizeof(typename L::Hdr) + sizeof(Model);
+    const uint64_t off_entry  = off_bucket + bucket_cnt * sizeof(Bucket);
+    const uint64_t off_val    = off_entry + n_rec * sizeof(Ent);
+    const uint64_t total      = off_val + plan.n_val;
+
+    TableOutput out;
+    if (!out.Create(output, total, split, plan.sum_chunk)) return false;
+    char* base = out.data();
+    Bucket* bucket = reinterpret_cast<Bucket*>(base + off_bucket);
+    Ent* entries = reinterpret_cast<Ent*>(base + off_entry);
+    char* val_pool = base + off_val;
+
+    typename L::Hdr hdr{};
+    std::memcpy(hdr.magic, "STRATEGY", 8);
+    hdr.version = L::kVersion;
+    hdr.model_cnt = 1;
+    hdr.bucket_cnt = static_cast<decltype(hdr.bucket_cnt)>(bucket_cnt);
+    hdr.entry_cnt = static_cast<decltype(hdr.entry_cnt)>(n_rec);
+    hdr.val_pool_sz = static_cast<decltype(hdr.val_pool_sz)>(plan.n_val);
+    std::memcpy(base, &hdr, sizeof(hdr));
+    Model m{model_id, model_version};
+    std::memcpy(base + sizeof(hdr), &m, sizeof(Model));
+
+    // pass 2: 桶计数 -> 起始下标; 任一段读失败则放弃输出 (pass 1 之后输入不应再出错)
+    std::atomic<bool> ok{true};
+    auto read_fail = [&](const char* pass) {
+        LOG_ERROR << "build " << pass << " read fail: " << output << std::endl;
+        out.Abort();
+        return false;
+    };
+    ParallelFor(threads, [&](uint32_t t) {
+        uint64_t dummy = 0;
+        if (!ForEachRecord(in, cut[t], cut[t + 1], &dummy, [&](std::string_view k, std::string_view) {
+                __atomic_fetch_add(&bucket[L::Tag(HashKey64(k)) & mask], Bucket(1), __ATOMIC_RELAXED);
+            })) ok = false;
+    });
+    if (!ok) return read_fail("pass 2");
+    Bucket acc = 0;
+    for (uint64_t b = 0; b < bucket_cnt; ++b) {
+        Bucket c = bucket[b];
+        bucket[b] = acc;
+        acc += c;
+    }
+
+    // pass 3: 写 value + Entry 落位 (bucket[b] 兼作游标, 结束后变为桶尾)
+    static const uint64_t kFlushWindow = 64ull << 20;
+    ParallelFor(threads, [&](uint32_t t) {
+        uint64_t dummy = 0;
+        uint64_t voff = plan.val_base[t];
+        uint64_t flushed = voff;
+        if (!ForEachRecord(in, cut[t], cut[t + 1], &dummy, [&](std::string_view k, std::string_view v) {
+                auto h = L::Tag(HashKey64(k));
+                Bucket slot = __atomic_fetch_add(&bucket[h & mask], Bucket(1), __ATOMIC_RELAXED);
+                entries[slot] = Ent{h, static_cast<decltype(Ent::value_offset)>(voff),
+                                    static_cast<decltype(Ent::value_size)>(v.size())};
+                std::memcpy(val_pool + voff, v.data(), v.size());
+                voff += v.size();
+                if (voff - flushed >= kFlushWindow) {
+                    uint64_t a = (off_val + flushed + 4095) & ~4095ull;
+                    uint64_t z = (off_val + voff) & ~4095ull;
+                    if (z > a) ::madvise(base + a, z - a, MADV_DONTNEED);
+                    flushed = voff;
+                }
+            })) ok = false;
+    });
+    if (!ok) return read_fail("pass 3");
+    for (uint64_t b = bucket_cnt - 1; b > 0; --b) bucket[b] = bucket[b - 1];
+    bucket[0] = 0;
+
+    // 桶内排序, 输出与线程调度无关
+    ParallelFor(threads, [&](uint32_t t) {
+        uint64_t b0 = bucket_cnt * t / threads;
+        uint64_t b1 = bucket_cnt * (t + 1) / threads;
+        for (uint64_t b = b0; b < b1; ++b) {
+            uint64_t e = (b == mask) ? n_rec : bucket[b + 1];
+            if (e - bucket[b] > 1) {
+                std::sort(entries + bucket[b], entries + e, [](const Ent& x, const Ent& y) {
+                    return x.key_hash != y.key_hash ? x.key_hash < y.key_hash
+                                                    : x.value_offset < y.value_offset;
+                });
+            }
+        }
+    });
+
+    // pass 4 (仅当有相同 key_hash 的条目时): 表里不存 key, 相同 hash 既可能是重复 key (先出现者生效),
+    // 也可能是不同 key 撞了 hash (v1 只存 32 位), 后者会让 reader 把一个 key 答成另一个的 value.
+    // 重读输入比对这些 hash 下的 key 原文; 有碰撞即放弃输出, 由调用方改用 v2 或报错.
+    std::vector<std::vector<Hash>> same(threads);
+    ParallelFor(threads, [&](uint32_t t) {
+        uint64_t b0 = bucket_cnt * t / threads;
+        uint64_t b1 = bucket_cnt * (t + 1) / threads;
+        for (uint64_t b = b0; b < b1; ++b) {
+            uint64_t e = (b == mask) ? n_rec : bucket[b + 1];
+            for (uint64_t i = bucket[b] + 1; i < e; ++i) {
+                const auto h = entries[i].key_hash;
+                if (h == entries[i - 1].key_hash && (same[t].empty() || same[t].back() != h)) same[t].push_back(h);
+            }
+        }
+    });
+    std::set<Hash> tags;
+    for (const auto& v : same) tags.insert(v.begin(), v.end());
+    uint64_t collisions = 0;
+    if (!tags.empty()) {
+        std::vector<std::map<Hash, std::set<std::string>>> keys(threads);
+        ParallelFor(threads, [&](uint32_t t) {
+            uint64_t dummy = 0;
+            if (!ForEachRecord(in, cut[t], cut[t + 1], &dummy, [&](std::string_view k, std::string_view) {
+                    auto h = L::Tag(HashKey64(k));
+                    if (tags.count(h)) keys[t][h].emplace(k);
+                })) ok = false;
+        });
+        if (!ok) return read_fail("pass 4");
+        for (uint32_t t = 1; t < threads; ++t)
+            for (auto& kv : keys[t]) keys[0][kv.first].merge(kv.second);
+        for (const auto& kv : keys[0]) collisions += kv.second.size() - 1;
+    }
+    *out_collisions = collisions;
+    if (collisions) {
+        out.Abort();
+        return false;
+    }
+
+    *out_parts = out.Parts();
+    if (!out.Commit(threads)) return false;
+    *out_total = total;
+    *out_buckets = bucket_cnt;
+    return true;
+}
+
+// v3 (swiss): 组数取装载率 <= 7/8 的最小 2 的幂. 记录按 home 组 (hash & mask) 顺序连续落位
+// (有序线性探测): 组 g 的 run 从 max(g * 16, 上一 run 末尾) 开始, 因此 home 组到所在组之间全满,
+// 与 reader "遇到空槽即停" 的探测一致. 末尾溢出的 run 绕回表头. 每个 run 内按 (hash, kv_offset)
+// 排序, 输出与线程数无关, 重复 key 先出现者生效.
+static bool BuildSwissTable(const BuildPlan& plan, const std::string& output, uint32_t model_id,
+                            uint32_t model_version, uint64_t split, uint64_t* out_total, size_t* out_parts,
+                            uint64_t* out_groups) {
+    const uint32_t threads = plan.threads;
+    const auto& cut = plan.cut;
+    const int in = plan.in;
+    const uint64_t n_rec = plan.n_rec;
+    uint64_t group_cnt = 1;
+    while (group_cnt * kSwissGroup * 7 < (n_rec + 1) * 8) group_cnt <<= 1;
+    const uint64_t cap = group_cnt * kSwissGroup;
+    const uint64_t mask = group_cnt - 1;
+
+    const uint64_t kv_sz = plan.n_key + plan.n_val;
+    const SwissLayout l = SwissLayoutOf(1, group_cnt, kv_sz);
+    const uint64_t off_kv = l.kv;
+    const uint64_t total = l.end;
+
+    TableOutput out;
+    if (!out.Create(output, total, split, plan.sum_chunk)) return false;
+    char* base = out.data();
+    uint8_t* ctrl = reinterpret_cast<uint8_t*>(base + l.ctrl);
+    SlotV3* slots = reinterpret_cast<SlotV3*>(base + l.slots);
+    char* kv_pool = base + off_kv;
+
+    FrozenHeaderV3 hdr{};
+    std::memcpy(hdr.magic, "STRATEGY", 8);
+    hdr.version = 3;
+    hdr.model_cnt = 1;
+    hdr.group_cnt = group_cnt;
+    hdr.entry_cnt = n_rec;
+    hdr.val_pool_sz = kv_sz;
+    std::memcpy(base, &hdr, sizeof(hdr));
+    Model m{model_id, model_version};
+    std::memcpy(base + sizeof(hdr), &m, sizeof(Model));
+    std::memset(ctrl, kCtrlEmpty, cap + kSwissGroup);
+
+    // pass 2: 每个 home 组的记录数 (每组 8 字节游标, 即每槽 0.5 字节进程内存)
+    // 读失败时槽位未填但控制字节会标成占用, 必须放弃输出
+    std::vector<uint64_t> cursor(group_cnt, 0);
+    std::atomic<bool> ok{true};
+    auto read_fail = [&](const char* pass) {
+        LOG_ERROR << "build " << pass << " read fail: " << output << std::endl;
+        out.Abort();
+        return false;
+    };
+    ParallelFor(threads, [&](uint32_t t) {
+        uint64_t dummy = 0;
+        if (!ForEachRecord(in, cut[t], cut[t + 1], &dummy, [&](std::string_view k, std::string_view) {
+                __atomic_fetch_add(&cursor[HashKey64(k) & mask], uint64_t(1), __ATOMIC_RELAXED);
+            })) ok = false;
+    });
+    if (!ok) return read_fail("pass 2");
+    // 绕回量 wrap 是 "run 末尾超出 cap 的部分", 它又占据表头, 迭代到不动点 (装载率 < 1 保证收敛)
+    uint64_t wrap = 0;
+    for (;;) {
+        uint64_t end = wrap;
+        for (uint64_t g = 0; g < group_cnt; ++g) end = std::max(g * kSwissGroup, end) + cursor[g];
+        const uint64_t over = end > cap ? end - cap : 0;
+        if (over <= wrap) break;
+        wrap = over;
+    }
+    // 计数 -> run 起点 (未取模的位置, 落槽时 & (cap - 1))
+    for (uint64_t g = 0, prev = wrap; g < group_cnt; ++g) {
+        const uint64_t start = std::max(g * kSwissGroup, prev);
+        prev = start + cursor[g];
+        cursor[g] = start;
+    }
+
+    // pass 3: 写 key+value, 槽位按游标落位 (结束后 cursor[g] 为 run 末尾)
+    static const uint64_t kFlushWindow = 64ull << 20;
+    ParallelFor(threads, [&](uint32_t t) {
+        uint64_t dummy = 0;
+        uint64_t off = plan.val_base[t] + plan.key_base[t];
+        uint64_t flushed = off;
+        if (!ForEachRecord(in, cut[t], cut[t + 1], &dummy, [&](std::string_view k, std::string_view v) {
+                const uint64_t h = HashKey64(k);
+                const uint64_t pos = __atomic_fetch_add(&cursor[h & mask], uint64_t(1), __ATOMIC_RELAXED);
+                slots[pos & (cap - 1)] =
+                    SlotV3{h, off, static_cast<uint32_t>(k.size()), static_cast<uint32_t>(v.size())};
+                std::memcpy(kv_pool + off, k.data(), k.size());
+                std::memcpy(kv_pool + off + k.size(), v.data(), v.size());
+                off += k.size() + v.size();
+                if (off - flushed >= kFlushWindow) {
+                    uint64_t a = (off_kv + flushed + 4095) & ~4095ull;
+                    uint64_t z = (off_kv + off) & ~4095ull;
+                    if (z > a) ::madvise(base + a, z - a, MADV_DONTNEED);
+                    flushed = off;
+                }
+            })) ok = false;
+    });
+    if (!ok) return read_fail("pass 3");
+
+    // run 内排序 + 控制字节; 不同 run 的槽位互不重叠, 可按组并行
+    ParallelFor(threads, [&](uint32_t t) {
+        const uint64_t g0 = group_cnt * t / threads;
+        const uint64_t g1 = group_cnt * (t + 1) / threads;
+        std::vector<SlotV3> tmp;
+        auto less = [](const SlotV3& x, const SlotV3& y) {
+            return x.key_hash != y.key_hash ? x.key_hash < y.key_hash : x.kv_offset < y.kv_offset;
+        };
+        for (uint64_t g = g0; g < g1; ++g) {
+            const uint64_t start = g ? std::max(g * kSwissGroup, cursor[g - 1]) : wrap;
+            const uint64_t end = cursor[g];
+            if (end - start > 1) {
+                if ((start & ~(cap - 1)) == ((end - 1) & ~(cap - 1))) {
+                    std::sort(slots + (start & (cap - 1)), slots + ((end - 1) & (cap - 1)) + 1, less);
+                } else {
+                    tmp.clear();
+                    for (uint64_t p = start; p < end; ++p) tmp.push_back(slots[p & (cap - 1)]);
+                    std::sort(tmp.begin(), tmp.end(), less);
+                    for (uint64_t p = start; p < end; ++p) slots[p & (cap - 1)] = tmp[p - start];
+                }
+            }
+            for (uint64_t p = start; p < end; ++p) ctrl[p & (cap - 1)] = SwissH2(slots[p & (cap - 1)].key_hash);
+        }
+    });
+    std::memcpy(ctrl + cap, ctrl, kSwissGroup);
+
+    *out_parts = out.Parts();
+    if (!out.Commit(threads)) return false;
+    *out_total = total;
+    *out_groups = group_cnt;
+    return true;
+}
+
+// BUILD_FORMAT: v1 (32 位, 兼容旧 reader) / v2 (64 位) / swiss (v3, SIMD 组探测 + 存 key)
+// / auto (超出 v1 上限时自动 v2)
+// BUILD_SPLIT_MB: 非 0 时输出按该大小切片, <output> 为引用各分片的 STRATSEG 容器
+static bool BuildFrozenTable(const std::string& input, const std::string& output,
+                             uint32_t model_id = 1, uint32_t model_version = 1) {
+    auto begin_ts = std::chrono::steady_clock::now();
+    BuildPlan plan;
+    int in = ::open(input.c_str(), O_RDONLY);
+    if (in < 0) {
+        LOG_ERROR << "open input fail: " << input << " err=" << strerror(errno) << std::endl;
+        return false;
+    }
+    plan.in = in;
+    struct stat st{};
+    if (::fstat(in, &st) != 0) {
+        LOG_ERROR << "stat input fail: " << input << " err=" << strerror(errno) << std::endl;
+        ::close(in);
+        return false;
+    }
+    const uint64_t in_size = (uint64_t)st.st_size;
+    const uint32_t threads = plan.threads = DefaultThreads("BUILD_THREADS");
+    std::vector<uint64_t>& cut = plan.cut;
+    cut.assign(threads + 1, in_size);
+    for (uint32_t t = 0; t < threads; ++t) cut[t] = AlignToLine(in, in_size * t / threads, in_size);
+    ::posix_fadvise(in, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    // pass 1: 计数
+    std::vector<uint64_t> recs(threads, 0), vbytes(threads, 0), kbytes(threads, 0), bad(threads, 0), vmax(threads, 0);
+    std::atomic<bool> ok{true};
+    ParallelFor(threads, [&](uint32_t t) {
+        if (!ForEachRecord(in, cut[t], cut[t + 1], &bad[t], [&](std::string_view k, std::string_view v) {
+                ++recs[t];
+                vbytes[t] += v.size();
+                kbytes[t] += k.size();
+                vmax[t] = std::max<uint64_t>(vmax[t], std::max(k.size(), v.size()));
+            })) ok = false;
+    });
+    plan.val_base.assign(threads, 0);
+    plan.key_base.assign(threads, 0);
+    for (uint32_t t = 0; t < threads; ++t) {
+        plan.val_base[t] = plan.n_val;
+        plan.key_base[t] = plan.n_key;
+        plan.n_rec += recs[t];
+        plan.n_val += vbytes[t];
+        plan.n_key += kbytes[t];
+        plan.n_bad += bad[t];
+        plan.max_field = std::max(plan.max_field, vmax[t]);
+    }
+    const std::string format = GetEnvOrDefault("BUILD_FORMAT", "auto");
+    const bool swiss = format == "swiss" || format == "v3";
+    // v1 的 bucket_cnt 为 uint32: 桶数取 >= n_rec 的 2 的幂, 记录数超过 2^31 时会变成 2^32 而截断为 0
+    const bool fits_v1 = plan.n_rec <= (1ull << 31) && plan.n_val <= UINT32_MAX;
+    bool v2 = !swiss && (format == "v2" || (format != "v1" && !fits_v1));
+    if (!ok || (!swiss && !v2 && !fits_v1) || (swiss && plan.max_field > UINT32_MAX)) {
+        LOG_ERROR << "build input unusable: " << input << " records=" << plan.n_rec
+                  << " value_bytes=" << plan.n_val << " format=" << format << std::endl;
+        ::close(in);
+        return false;
+    }
+    const uint64_t split = std::strtoull(GetEnvOrDefault("BUILD_SPLIT_MB", "0").c_str(), nullptr, 10) << 20;
+    plan.sum_chunk = std::strtoull(GetEnvOrDefault("SUM_CHUNK_MB", "8").c_str(), nullptr, 10) << 20;
+    uint64_t total = 0, buckets = 0, collisions = 0;
+    size_t parts = 0;
+    bool built = swiss ? BuildSwissTable(plan, output, model_id, model_version, split, &total, &parts, &buckets)
+                 : v2  ? BuildTableT<LayoutV2>(plan, output, model_id, model_version, split, &total, &parts, &buckets,
+                                               &collisions)
+                       : BuildTableT<LayoutV1>(plan, output, model_id, model_version, split, &total, &parts, &buckets,
+                                               &collisions);
+    // v1 的 32 位 hash 有不同 key 相撞: auto 改建 v2 (64 位 hash), 显式 v1 则失败, 不写会答错的表
+    uint64_t v1_collisions = 0;
+    if (!built && collisions && !swiss && !v2 && format != "v1") {
+        LOG_INFO << "build " << output << " v1 hash collisions=" << collisions << ", rebuilding as v2" << std::endl;
+        v1_collisions = collisions;
+        v2 = true;
+        built = BuildTableT<LayoutV2>(plan, output, model_id, model_version, split, &total, &parts, &buckets,
+                                      &collisions);
+    }
+    ::close(in);
+    if (!built && collisions) {
+        LOG_ERROR << "build " << output << " format=" << (v2 ? "v2" : "v1") << " hash collisions=" << collisions
+                  << ": distinct keys share a key_hash" << (v2 ? "" : ", use BUILD_FORMAT=v2 or swiss") << std::endl;
+    }
+    if (!built) return false;
+    double cost = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin_ts).count();
+    LOG_INFO << "Built table: " << output
+             << " format=" << (swiss ? "swiss" : v2 ? "v2" : "v1") << (v1_collisions ? " v1_collisions=" + std::to_string(v1_collisions) : std::string())
+             << " records=" << plan.n_rec << " malformed=" << plan.n_bad << " collisions=" << collisions
+             << (swiss ? " groups=" : " buckets=") << buckets << " value_bytes=" << plan.n_val
+             << " size=" << total << " files=" << parts << " threads=" << threads
+             << " cost=" << cost << "s" << std::endl;
+    return true;
+}
+
+// === 合成查询表 (bench 用): key_<i> -> value_size 字节 ===
+static bool WriteSyntheticTable(const std::string& path, uint32_t keys, uint32_t value_size) {
+    std::string tsv = path + ".tsv";
+    {
+        std::ofstream ofs(tsv, std::ios::binary | std::ios::trunc);
+        if (!ofs) return false;
+        std::string val(value_size, 'v');
+        for (uint32_t i = 0; i < keys; ++i) ofs << "key_" << i << '\t' << val << '\n';
+        if (!ofs) return false;
+    }
+    bool ok = BuildFrozenTable(tsv, path);
+    std::remove(tsv.c_str());
+    return ok;
+}
+
+// === 查询压测: 标量 Get 循环 vs MultiGet ===
+static int BenchLookup(uint32_t keys, uint32_t batch) {
+    const std::string path = GetEnvOrDefault("BENCH_FILE", "/tmp/frozen_kv_bench");
+    const uint32_t value_size = 16;
+    if (keys == 0) keys = 1;
+    if (batch == 0) batch = 1;
+    if (!WriteSyntheticTable(path, keys, value_size)) {
+        LOG_ERROR << "write synthetic table fail: " << path << std::endl;
+        return EXIT_FAILURE;
+    }
+    FrozenHashMapImpl table;
+    if (!table.Build(path)) return EXIT_FAILURE;
+
+    // 随机顺序, 约 10% 的 miss
+    const size_t lookups = std::max<size_t>(keys, 4u << 20);
+    std::mt19937_64 rng(42);
+    std::vector<std::string> storage(lookups);
+    for (auto& k : storage) {
+        uint64_t r = rng() % (keys + keys / 10 + 1);
+        k = "key_" + std::to_string(r);
+    }
+    std::vector<std::string_view> views(storage.begin(), storage.end());
+    std::vector<std::string_view> out(lookups);
+
+    auto t0 = std::chrono::steady_clock::now();
+    size_t scalar_hits = 0;
+    for (size_t i = 0; i < lookups; ++i) {
+        if (table.Get(views[i], &out[i])) ++scalar_hits;
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    size_t batch_hits = 0;
+    for (size_t i = 0; i < lookups; i += batch) {
+        size_t n = std::min<size_t>(batch, lookups - i);
+        batch_hits += table.MultiGet(views.data() + i, n, out.data() + i);
+    }
+    auto t2 = std::chrono::steady_clock::now();
+
+    double scalar_s = std::chrono::duration<double>(t1 - t0).count();
+    double batch_s  = std::chrono::duration<double>(t2 - t1).count();
+    LOG_INFO << "bench-lookup keys=" << keys << " lookups=" << lookups << " batch=" << batch
+             << " format=v" << table.Version() << " probe=" << table.ProbeName()
+             << " scalar=" << (lookups / scalar_s / 1e6) << " Mops/s"
+             << " multiget=" << (lookups / batch_s / 1e6) << " Mops/s"
+             << " speedup=" << (scalar_s / batch_s)
+             << " hits=" << scalar_hits << "/" << batch_hits << std::endl;
+    std::remove(path.c_str());
+    return scalar_hits == batch_hits ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// LOAD_BACKEND / PREFETCH_* (reader watch 与 bench 共用)
+static LoadBackendOptions LoadBackendFromEnv() {
+    LoadBackendOptions b;
+    b.kind = GetEnvOrDefault("LOAD_BACKEND", "mmap");
+    b.huge_pages = ParseHugePageMode(GetEnvOrDefault("LOAD_HUGEPAGES", "off"));
+    b.uring_depth = std::max(1, std::atoi(GetEnvOrDefault("URING_DEPTH", "64").c_str()));
+    b.uring_block =
+        std::max<uint64_t>(4, std::strtoull(GetEnvOrDefault("URING_BLOCK_KB", "1024").c_str(), nullptr, 10)) << 10;
+    return b;
+}
+
+static PrefetchOptions PrefetchFromEnv() {
+    PrefetchOptions p;
+    p.threads = DefaultThreads("PREFETCH_THREADS");
+    p.chunk_bytes =
+        std::max<uint64_t>(1, std::strtoull(GetEnvOrDefault("PREFETCH_CHUNK_MB", "64").c_str(), nullptr, 10)) << 20;
+    p.bandwidth_bps = std::strtoull(GetEnvOrDefault("PREFETCH_BW_MBPS", "0").c_str(), nullptr, 10) << 20;
+    return p;
+}
+
+// === 基准套件 (bench): 冷/热加载耗时, 缺页数, 查询 QPS 与尾延迟, 输出 JSON ===
+// 冷加载前 fsync + POSIX_FADV_DONTNEED 丢掉表文件 (含 .part<k>) 的 page cache, 不需要 root;
+// 页被其他进程映射着时内核不会丢, 此时 cold 与 warm 接近, 以 major_faults 为准判断.
+static void DropTableCache(const std::string& path) {
+    for (int k = -1;; ++k) {
+        std::string p = k < 0 ? path : path + ".part" + std::to_string(k);
+        int fd = ::open(p.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            if (k < 0) continue;
+            break;
+        }
+        ::fdatasync(fd);
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        ::close(fd);
+    }
+}
+
+static void RemoveTable(const std::string& path) {
+    std::remove(path.c_str());
+    for (int k = 0; std::remove((path + ".part" + std::to_string(k)).c_str()) == 0; ++k) {}
+}
+
+struct BenchLoad {
+    double seconds = 0;
+    long major_faults = 0;
+    long minor_faults = 0;
+    uint64_t sim_requests = 0;     // STORAGE_SIM_PATH 下的模拟往返次数
+    std::string backend;
+};
+
+// 一次完整加载 (Map + Validate + Warm, 同 Build 但按 LOAD_BACKEND / PREFETCH_* 选后端与预取参数),
+// 缺页取 getrusage 前后差值
+static bool MeasureBuild(const std::string& path, bool cold, BenchLoad* r) {
+    if (cold) DropTableCache(path);
+    const SimulatedAccess* sim = StorageSim().get();
+    const uint64_t sim0 = sim ? sim->Requests() : 0;
+    struct rusage ru0, ru1;
+    ::getrusage(RUSAGE_SELF, &ru0);
+    auto t0 = std::chrono::steady_clock::now();
+    {
+        FrozenHashMapImpl table;
+        if (!table.Map(path, LoadBackendFromEnv()) || !table.Validate() || !table.Warm(PrefetchFromEnv(), nullptr))
+            return false;
+        r->backend = table.Backend()->name();
+        r->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        ::getrusage(RUSAGE_SELF, &ru1);
+    }
+    r->major_faults = ru1.ru_majflt - ru0.ru_majflt;
+    r->minor_faults = ru1.ru_minflt - ru0.ru_minflt;
+    r->sim_requests = sim ? sim->Requests() - sim0 : 0;
+    return true;
+}
+
+// 按 Zipf(s) 抽取 key 序号; s=0 为均匀. 连续分布求逆近似, 不需要 O(keys) 的 CDF 表.
+// 序号再乘一个与 n 互质的数取模 (128 位乘法不溢出, 是 [0, n) 上的置换) 打散, 热点 key 不会集中在表的
+// 同一段, 各 rank 也不会撞到同一个 key 上.
+class ZipfKeys {
+public:
+    ZipfKeys(uint64_t n, double s) : n_(std::max<uint64_t>(n, 1)), s_(s) {
+        if (s_ > 0 && std::fabs(s_ - 1.0) > 1e-9) span_ = std::pow((double)n_, 1.0 - s_) - 1.0;
+        mult_ = 0x9E3779B97F4A7C15ull % n_;
+        while (n_ > 1 && std::gcd(mult_, n_) != 1) ++mult_;
+    }
+    uint64_t Next(std::mt19937_64& rng) {
+        double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+        uint64_t rank;
+        if (s_ <= 0) {
+            rank = (uint64_t)(u * n_);
+        } else if (std::fabs(s_ - 1.0) <= 1e-9) {
+            rank = (uint64_t)std::exp(u * std::log((double)n_)) - 1;
+        } else {
+            rank = (uint64_t)std::pow(span_ * u + 1.0, 1.0 / (1.0 - s_)) - 1;
+        }
+        rank = std::min(rank, n_ - 1);
+        return uint64_t((unsigned __int128)rank * mult_ % n_);
+    }
+
+private:
+    uint64_t n_;
+    double s_;
+    double span_ = 0;
+    uint64_t mult_ = 1;
+};
+
+struct BenchLatency {
+    double qps = 0;      // 每秒 key 数
+    double p50_us = 0, p99_us = 0, p999_us = 0;
+    size_t hits = 0;
+};
+
+static void FillPercentiles(std::vector<uint64_t>& ns, BenchLatency* r) {
+    if (ns.empty()) return;
+    std::sort(ns.begin(), ns.end());
+    auto at = [&](double q) { return ns[std::min(ns.size() - 1, (size_t)(q * ns.size()))] / 1e3; };
+    r->p50_us = at(0.50);
+    r->p99_us = at(0.99);
+    r->p999_us = at(0.999);
+}
+
+// QPS 用不计时的整轮, 延迟另跑一轮逐次 (标量) / 逐批 (MultiGet) 采样, 采样开销不计入 QPS.
+static void MeasureLookups(const FrozenHashMapImpl& table, const std::vector<std::string_view>& keys,
+                           uint32_t batch, BenchLatency* scalar, BenchLatency* batched) {
+    const size_t n = keys.size();
+    std::vector<std::string_view> out(n);
+    std::vector<uint64_t> ns;
+    ns.reserve(n);
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < n; ++i) scalar->hits += table.Get(keys[i], &out[i]);
+    scalar->qps = n / std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    for (size_t i = 0; i < n; ++i) {
+        auto a = std::chrono::steady_clock::now();
+        table.Get(keys[i], &out[i]);
+        ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - a).count());
+    }
+    FillPercentiles(ns, scalar);
+
+    ns.clear();
+    t0 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < n; i += batch) {
+        batched->hits += table.MultiGet(keys.data() + i, std::min<size_t>(batch, n - i), out.data() + i);
+    }
+    batched->qps = n / std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    for (size_t i = 0; i < n; i += batch) {
+        auto a = std::chrono::steady_clock::now();
+        table.MultiGet(keys.data() + i, std::min<size_t>(batch, n - i), out.data() + i);
+        ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - a).count());
+    }
+    FillPercentiles(ns, batched);
+}
+
+// bench [out.json]: 结果写到文件, 省略时作为最后一行 (单行 JSON) 打到 stdout
+static int BenchSuite(const std::string& out_path) {
+    const std::string path = GetEnvOrDefault("BENCH_FILE", "/tmp/frozen_kv_bench");
+    const uint32_t keys = std::max<uint32_t>(1, std::strtoul(GetEnvOrDefault("BENCH_KEYS", "1000000").c_str(), nullptr, 10));
+    const uint32_t value_size = std::strtoul(GetEnvOrDefault("BENCH_VALUE_SIZE", "16").c_str(), nullptr, 10);
+    const double skew = std::max(0.0, std::atof(GetEnvOrDefault("BENCH_SKEW", "0").c_str()));
+    const double miss = std::min(1.0, std::max(0.0, std::atof(GetEnvOrDefault("BENCH_MISS_PCT", "10").c_str()) / 100.0));
+    const uint32_t batch = std::max<uint32_t>(1, std::strtoul(GetEnvOrDefault("BENCH_BATCH", "64").c_str(), nullptr, 10));
+    const size_t lookups = std::max<size_t>(1, std::strtoull(GetEnvOrDefault("BENCH_LOOKUPS", "4194304").c_str(), nullptr, 10));
+
+    if (!WriteSyntheticTable(path, keys, value_size)) {
+        LOG_ERROR << "write synthetic table fail: " << path << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    BenchLoad cold, warm;
+    bool ok = MeasureBuild(path, true, &cold) && MeasureBuild(path, false, &warm);
+    FrozenHashMapImpl table;
+    ok = ok && table.Build(path);
+    if (!ok) {
+        RemoveTable(path);
+        return EXIT_FAILURE;
+    }
+
+    // miss 取 [keys, 2*keys) 之外不存在的序号, 与命中 key 同样长度分布
+    std::mt19937_64 rng(42);
+    ZipfKeys zipf(keys, skew);
+    std::vector<std::string> storage(lookups);
+    for (auto& k : storage) {
+        bool is_miss = std::uniform_real_distribution<double>(0.0, 1.0)(rng) < miss;
+        k = "key_" + std::to_string(is_miss ? keys + rng() % keys : zipf.Next(rng));
+    }
+    std::vector<std::string_view> views(storage.begin(), storage.end());
+    BenchLatency scalar, batched;
+    MeasureLookups(table, views, batch, &scalar, &batched);
+    ok = scalar.hits == batched.hits;
+
+    auto load_json = [](const BenchLoad& l) {
+        std::ostringstream o;
+        o << "{\"backend\":\"" << l.backend << "\",\"seconds\":" << l.seconds << ",\"major_faults\":" << l.major_faults
+          << ",\"minor_faults\":" << l.minor_faults << ",\"sim_requests\":" << l.sim_requests << "}";
+        return o.str();
+    };
+    auto lookup_json = [](const BenchLatency& l) {
+        std::ostringstream o;
+        o << "{\"qps\":" << l.qps << ",\"p50_us\":" << l.p50_us << ",\"p99_us\":" << l.p99_us
+          << ",\"p999_us\":" << l.p999_us << ",\"hits\":" << l.hits << "}";
+        return o.str();
+    };
+    std::ostringstream js;
+    js << "{\"table\":{\"keys\":" << keys << ",\"value_size\":" << value_size << ",\"bytes\":" << table.MappedSize()
+       << ",\"format\":\"v" << table.Version() << "\",\"probe\":\"" << table.ProbeName() << "\""
+       << ",\"storage\":\"" << FileAccess::For(path).name() << "\"}"
+       << ",\"workload\":{\"lookups\":" << lookups << ",\"skew\":" << skew << ",\"miss_pct\":" << miss * 100
+       << ",\"batch\":" << batch << "}"
+       << ",\"load\":{\"cold\":" << load_json(cold) << ",\"warm\":" << load_json(warm) << "}"
+       << ",\"lookup\":{\"scalar\":" << lookup_json(scalar) << ",\"batched\":" << lookup_json(batched) << "}"
+       << ",\"ok\":" << (ok ? "true" : "false") << "}";
+    RemoveTable(path);
+
+    if (out_path.empty()) {
+        std::cout << js.str() << std::endl;
+    } else if (!AtomicWriteFile(out_path, js.str() + "\n")) {
+        LOG_ERROR << "write bench result fail: " << out_path << std::endl;
+        return EXIT_FAILURE;
+    } else {
+        LOG_INFO << "bench result: " << out_path << std::endl;
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// === Manifest 变更通知 ===
+// 本地文件系统 / 同节点写入走 inotify (监听所在目录, 覆盖 AtomicWriteFile 的 rename);
+// blobfuse 等 FUSE 挂载收不到远端写入的事件, 退回自适应轮询: 发现变化后收紧到
+// min_interval, 空闲时逐次翻倍直到 max_interval, 减少 attr_timeout=0 下的元数据往返.
+#ifndef FUSE_SUPER_MAGIC
+#define FUSE_SUPER_MAGIC 0x65735546
+#endif
+
+class ManifestWatcher {
+public:
+    virtual ~ManifestWatcher() = default;
+    // 阻塞至可能有变化或超时; 返回 true 表示应检查 manifest
+    virtual bool Wait(std::chrono::milliseconds max_wait, const std::atomic<bool>& running) = 0;
+    // 每次检查后反馈是否真的变化, 供轮询器调整间隔
+    virtual void OnChecked(bool /*changed*/) {}
+    virtual const char* name() const = 0;
+};
+
+// 以 100ms 片段睡眠, 保证 running 置 false 后及时退出
+static void SleepSliced(std::chrono::milliseconds total, const std::atomic<bool>& running) {
+    auto deadline = std::chrono::steady_clock::now() + total;
+    while (running) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (left.count() <= 0) break;
+        std::this_thread::sleep_for(std::min(left, std::chrono::milliseconds(100)));
+    }
+}
+
+class PollWatcher : public ManifestWatcher {
+public:
+    PollWatcher(std::chrono::milliseconds min_interval, std::chrono::milliseconds max_interval)
+        : min_(min_interval), max_(std::max(min_interval, max_interval)), cur_(min_interval) {}
+
+    bool Wait(std::chrono::milliseconds max_wait, const std::atomic<bool>& running) override {
+        SleepSliced(std::min(cur_, max_wait), running);
+        return true;
+    }
+    void OnChecked(bool changed) override {
+        cur_ = changed ? min_ : std::min(max_, cur_ * 2);
+    }
+    const char* name() const override { return "poll"; }
+
+private:
+    std::chrono::milliseconds min_, max_, cur_;
+};
+
+class InotifyWatcher : public ManifestWatcher {
+public:
+    ~InotifyWatcher() override {
+        if (fd_ >= 0) close(fd_);
+    }
+    bool Open(const std::string& manifest) {
+        size_t slash = manifest.find_last_of('/');
+        std::string dir = slash == std::string::npos ? "." : (slash == 0 ? "/" : manifest.substr(0, slash));
+        file_ = slash == std::string::npos ? manifest : manifest.substr(slash + 1);
+        fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd_ < 0) return false;
+        if (inotify_add_watch(fd_, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ATTRIB) < 0) {
+            close(fd_);
+            fd_ = -1;
+            return false;
+        }
+        return true;
+    }
+    // 超时也返回 true: 兜底检查一次, 防止漏事件
+    bool Wait(std::chrono::milliseconds max_wait, const std::atomic<bool>& running) override {
+        auto deadline = std::chrono::steady_clock::now() + max_wait;
+        while (running) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            if (left.count() <= 0) return true;
+            struct pollfd pfd{fd_, POLLIN, 0};
+            int rc = poll(&pfd, 1, static_cast<int>(std::min<long long>(left.count(), 100)));
+            if (rc > 0 && Drain()) return true;
+        }
+        return false;
+    }
+    const char* name() const override { return "inotify"; }
+
+private:
+    // 读空事件队列, 返回是否涉及 manifest 本身 (忽略 .tmp 等同目录文件)
+    bool Drain() {
+        alignas(struct inotify_event) char buf[4096];
+        bool hit = false;
+        for (;;) {
+            ssize_t n = read(fd_, buf, sizeof(buf));
+            if (n <= 0) break;
+            for (char* p = buf; p < buf + n;) {
+                auto* ev = reinterpret_cast<struct inotify_event*>(p);
+                if ((ev->mask & IN_Q_OVERFLOW) || (ev->len > 0 && file_ == ev->name)) hit = true;
+                p += sizeof(struct inotify_event) + ev->len;
+            }
+        }
+        return hit;
+    }
+
+    int fd_ = -1;
+    std::string file_;
+};
+
+static bool IsFuseMount(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    std::string dir = slash == std::string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+    struct statfs sf{};
+    return statfs(dir.c_str(), &sf) == 0 && static_cast<unsigned long>(sf.f_type) == FUSE_SUPER_MAGIC;
+}
+
+// mode: auto (FUSE -> poll, 其余 inotify) / inotify / poll
+static std::unique_ptr<ManifestWatcher> MakeManifestWatcher(const std::string& manifest, const std::string& mode,
+                                                            std::chrono::milliseconds min_interval,
+                                                            std::chrono::milliseconds max_interval) {
+    bool want_inotify = mode == "inotify" || (mode != "poll" && !IsFuseMount(manifest));
+    if (want_inotify) {
+        std::unique_ptr<InotifyWatcher> w(new InotifyWatcher());
+        if (w->Open(manifest)) return std::unique_ptr<ManifestWatcher>(w.release());
+        LOG_ERROR << "inotify unavailable (" << std::strerror(errno) << "), fallback to poll" << std::endl;
+    }
+    return std::unique_ptr<ManifestWatcher>(new PollWatcher(min_interval, max_interval));
+}
+
+static double MtimeSeconds(const struct stat& st) {
+    return st.st_mtim.tv_sec + st.st_mtim.tv_nsec / 1e9;
+}
+
+static double WallSeconds() {
+    return std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
 
-        base_ = static_cast<const char*>(region_->get_address());
-        std::size_t fsz = region_->get_size();
-        if (fsz < sizeof(Header)) {
-            LOG_ERROR << "file too small: " << file << std::endl;
-            return false;
-        }
+// === 版本租约 ===
+// 共享卷上 <base>.leases/<reader_id>.lease (key=value, AtomicWriteFile 发布):
+// reader 声明正在服务 / 正在加载的目标, 每个 housekeeping 周期刷新 heartbeat_ns.
+// writer 只删除没有存活租约的旧版本; heartbeat 超过 LEASE_TIMEOUT_SEC 视为 reader 已死.
+static uint64_t WallNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
 
-        hdr_ = reinterpret_cast<const Header*>(base_);
-        if (std::strncmp(hdr_->magic, "STRATEGY", 8) != 0 || hdr_->version != 1) {
-            LOG_ERROR << "bad header in file: " << file
-                      << ", magic: " << std::string(hdr_->magic, 8)
-                      << ", version: " << hdr_->version << std::endl;
-            return false;
-        }
+static std::string LeaseDir(const std::string& base) { return base + ".leases"; }
 
-        models_   = reinterpret_cast<const Model*>(base_ + sizeof(Header));
-        bucket_   = reinterpret_cast<const uint32_t*>(models_ + hdr_->model_cnt);
-        entries_  = reinterpret_cast<const Entry*>(bucket_ + hdr_->bucket_cnt);
-        val_pool_ = reinterpret_cast<const char*>(entries_ + hdr_->entry_cnt);
-        mask_     = hdr_->bucket_cnt ? (hdr_->bucket_cnt - 1) : 0;
-        size_     = hdr_->entry_cnt;
+// x.manifest -> x
+static std::string BaseFromManifest(const std::string& manifest) {
+    static const std::string kSuffix = ".manifest";
+    if (manifest.size() > kSuffix.size() &&
+        manifest.compare(manifest.size() - kSuffix.size(), kSuffix.size(), kSuffix) == 0)
+        return manifest.substr(0, manifest.size() - kSuffix.size());
+    return manifest;
+}
 
-        PrefetchAndTouch(fsz);
+struct LeaseRecord {
+    std::string reader;
+    uint64_t generation = 0;
+    std::string target;    // 正在服务
+    std::string loading;   // 正在加载 (可空)
+    uint64_t heartbeat_ns = 0;
+};
 
-        std::stringstream ss;
-        ss << "load model:";
-        for (uint32_t i = 0; i < hdr_->model_cnt; ++i) {
-            auto m = models_[i];
-            if (m.model_id == 0 || m.version == 0) {
-                LOG_ERROR << "bad model in file: " << file
-                          << ", model_id: " << m.model_id
-                          << ", version: " << m.version << std::endl;
-                return false;
-            }
-            ss << " <" << m.model_id << ":" << m.version << ">";
-        }
+class ReaderLease {
+public:
+    ~ReaderLease() { Release(); }
 
-        double cost = std::chrono::duration<double>(
-            std::chrono::system_clock::now() - begin).count();
-        SPD_LOG_INFO(" {} success", ss.str());
-        SPD_LOG_INFO(" kv file: {}, entry count: {}, bucket count: {}, value pool size: {}, successfully !, cost: {:.2f}s",
-                     file, hdr_->entry_cnt, hdr_->bucket_cnt, hdr_->val_pool_sz, cost);
+    bool Open(const std::string& dir, const std::string& reader_id) {
+        if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+            LOG_ERROR << "[lease] mkdir fail: " << dir << " err=" << std::strerror(errno) << std::endl;
+            return false;
+        }
+        rec_.reader = reader_id;
+        path_ = dir + "/" + reader_id + ".lease";
         return true;
     }
 
-private:
-    void PrefetchAndTouch(std::size_t sz) {
-        if (!base_ || sz == 0) return;
-        ::madvise(const_cast<char*>(base_), sz, MADV_WILLNEED);
-#ifdef MADV_POPULATE_READ
-        ::madvise(const_cast<char*>(base_), sz, MADV_POPULATE_READ);
-#endif
-        TouchPages(base_, sz);
+    // 切换开始前调用: 先声明要加载的目标, writer 才不会在 map 前删掉它
+    void Update(uint64_t generation, const std::string& target, const std::string& loading) {
+        rec_.generation = generation;
+        rec_.target = target;
+        rec_.loading = loading;
+        Heartbeat();
     }
 
-private:
-    std::string file_path_;
-    std::unique_ptr<bip::file_mapping>   fmap_;
-    std::unique_ptr<bip::mapped_region>  region_;
+    void Heartbeat() {
+        if (path_.empty()) return;
+        rec_.heartbeat_ns = WallNanos();
+        std::ostringstream oss;
+        oss << "reader=" << rec_.reader << "\n"
+            << "generation=" << rec_.generation << "\n"
+            << "target=" << rec_.target << "\n"
+            << "loading=" << rec_.loading << "\n"
+            << "heartbeat_ns=" << rec_.heartbeat_ns << "\n";
+        if (!AtomicWriteFile(path_, oss.str())) LOG_ERROR << "[lease] write fail: " << path_ << std::endl;
+    }
 
-    const char* base_{nullptr};
-    const Header* hdr_{nullptr};
-    const Model* models_{nullptr};
-    const uint32_t* bucket_{nullptr};
-    const Entry* entries_{nullptr};
-    const char* val_pool_{nullptr};
-    uint32_t mask_{0};
-    uint32_t size_{0};
-};
+    void Release() {
+        if (path_.empty()) return;
+        std::remove(path_.c_str());
+        path_.clear();
+    }
 
-#ifdef __GNUC__
-#pragma GCC diagnostic pop
-#endif
+private:
+    std::string path_;
+    LeaseRecord rec_;
+};
 
-// === 工具函数 ===
-static std::string GetEnvOrDefault(const char* k, const std::string& defv) {
-    const char* v = std::getenv(k);
-    return (v && *v) ? std::string(v) : defv;
-}
-static bool FileExistsNonEmpty(const std::string& path) {
-    struct stat st{};
-    return stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0;
-}
-static bool AtomicWriteFile(const std::string& path, const std::string& content) {
-    std::string tmp = path + ".tmp";
-    std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
-    if (!ofs) return false;
-    ofs.write(content.data(), content.size());
-    ofs.close();
-    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
-        std::remove(tmp.c_str());
-        return false;
-    }
-    return true;
-}
-static bool WriteManifest(const std::string& manifest_path, const std::string& target_path) {
-    return AtomicWriteFile(manifest_path, target_path + "\n");
-}
-static bool ReadManifest(const std::string& manifest_path, std::string* out_target) {
-    std::ifstream ifs(manifest_path);
+static bool ReadLease(const std::string& path, LeaseRecord* out) {
+    std::ifstream ifs(path);
     if (!ifs) return false;
     std::string line;
     while (std::getline(ifs, line)) {
-        size_t a = line.find_first_not_of(" \t\r\n");
-        if (a == std::string::npos) continue;
-        size_t b = line.find_last_not_of(" \t\r\n");
-        *out_target = line.substr(a, b - a + 1);
-        return true;
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) continue;
+        std::string k = line.substr(0, eq), v = line.substr(eq + 1);
+        if (k == "reader") out->reader = v;
+        else if (k == "generation") out->generation = std::strtoull(v.c_str(), nullptr, 10);
+        else if (k == "target") out->target = v;
+        else if (k == "loading") out->loading = v;
+        else if (k == "heartbeat_ns") out->heartbeat_ns = std::strtoull(v.c_str(), nullptr, 10);
     }
-    return false;
+    return out->heartbeat_ns != 0;
 }
 
-// === 生成大模型文件（简单 Header + 填充）===
-static bool GenerateBigModelFile(const std::string& path,
-                                 uint64_t total_bytes,
-                                 uint32_t model_id = 1,
-                                 uint32_t model_version = 1) {
-    if (total_bytes < sizeof(FrozenHeader) + sizeof(Model)) {
-        LOG_ERROR << "size too small: " << total_bytes << std::endl;
-        return false;
+// 列出存活租约; 过期的只记日志, 不主动删除 (reader 重启会覆盖同名文件)
+static std::vector<LeaseRecord> LiveLeases(const std::string& dir, int timeout_sec) {
+    std::vector<LeaseRecord> out;
+    DIR* d = opendir(dir.c_str());
+    if (!d) return out;
+    const uint64_t now = WallNanos();
+    while (struct dirent* e = readdir(d)) {
+        std::string name = e->d_name;
+        if (name.size() <= 6 || name.compare(name.size() - 6, 6, ".lease") != 0) continue;
+        LeaseRecord r;
+        if (!ReadLease(dir + "/" + name, &r)) continue;
+        if (now > r.heartbeat_ns && now - r.heartbeat_ns > uint64_t(timeout_sec) * 1000000000ULL) {
+            LOG_INFO << "[lease] expired reader=" << r.reader << " target=" << r.target << std::endl;
+            continue;
+        }
+        out.push_back(r);
     }
-    int fd = ::open(path.c_str(), O_CREAT | O_RDWR, 0644);
-    if (fd < 0) {
-        LOG_ERROR << "open fail: " << path << " err=" << strerror(errno) << std::endl;
-        return false;
+    closedir(d);
+    return out;
+}
+
+// === 重启交接 (HANDOFF_SOCKET) ===
+// reader 启动时先 connect 该 socket: 旧进程回 "HANDOFF kind=<memfd|file> version=<v>\n" + manifest 文本,
+// SCM_RIGHTS 携带正在服务表的 fd (memfd 或模型文件), 新进程直接映射已常驻的页, 免去冷加载; 随后新进程
+// bind 同一路径 (顶替旧进程的名字), 为下一次重启服务. SIGTERM 时若路径仍属于自己 (接任者还没启动),
+// 继续应答最多 HANDOFF_WAIT_SEC, 被取走或路径被接任者占用后退出.
+class HandoffServer {
+public:
+    explicit HandoffServer(TableSnapshot& snapshot) : snapshot_(snapshot) {}
+    ~HandoffServer() {
+        running_ = false;
+        if (server_.joinable()) server_.join();
+        if (fd_ >= 0) {
+            if (Ours()) ::unlink(path_.c_str());
+            ::close(fd_);
+        }
     }
-    if (posix_fallocate(fd, 0, (off_t)total_bytes) != 0) {
-        LOG_ERROR << "posix_fallocate fail: " << path << std::endl;
-        ::close(fd);
-        return false;
+
+    // 向前任取表; 没有前任 (无人监听) 或前任没有可交出的表时返回 false
+    static bool Receive(const std::string& path, ManifestInfo* m, int* fd, bool* memfd) {
+        struct sockaddr_un addr{};
+        if (path.size() >= sizeof(addr.sun_path)) return false;
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, path.c_str(), path.size());
+        int s = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (s < 0) return false;
+        if (::connect(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            ::close(s);
+            return false;
+        }
+        struct timeval tv{5, 0};
+        ::setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        *fd = -1;
+        std::string text;
+        char buf[4096];
+        alignas(struct cmsghdr) char ctl[CMSG_SPACE(sizeof(int))];
+        for (;;) {
+            struct iovec iov{buf, sizeof(buf)};
+            struct msghdr msg{};
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            msg.msg_control = ctl;
+            msg.msg_controllen = sizeof(ctl);
+            ssize_t n = ::recvmsg(s, &msg, MSG_CMSG_CLOEXEC);
+            if (n <= 0) break;
+            for (struct cmsghdr* c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+                if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_RIGHTS && *fd < 0)
+                    std::memcpy(fd, CMSG_DATA(c), sizeof(int));
+            }
+            text.append(buf, n);
+        }
+        ::close(s);
+        std::istringstream iss(text);
+        std::string head;
+        std::getline(iss, head);
+        int version = 0;
+        char kind[16] = {0};
+        bool ok = *fd >= 0 && std::sscanf(head.c_str(), "HANDOFF kind=%15s version=%d", kind, &version) == 2 &&
+                  ParseManifest(iss, m);
+        if (!ok) {
+            if (*fd >= 0) ::close(*fd);
+            *fd = -1;
+            return false;
+        }
+        m->version = version;
+        *memfd = std::strcmp(kind, "memfd") == 0;
+        return true;
     }
-    void* addr = mmap(nullptr, total_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-    if (addr == MAP_FAILED) {
-        LOG_ERROR << "mmap fail: " << path << " err=" << strerror(errno) << std::endl;
-        ::close(fd);
-        return false;
+
+    // 占用路径 (替换前任留下的名字) 并开始应答
+    bool Listen(const std::string& path) {
+        struct sockaddr_un addr{};
+        if (path.size() >= sizeof(addr.sun_path)) {
+            LOG_ERROR << "[handoff] socket path too long: " << path << std::endl;
+            return false;
+        }
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, path.c_str(), path.size());
+        ::unlink(path.c_str());
+        int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        struct stat st{};
+        if (fd < 0 || ::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(fd, 8) != 0 ||
+            ::stat(path.c_str(), &st) != 0) {
+            LOG_ERROR << "[handoff] listen fail: " << path << " err=" << std::strerror(errno) << std::endl;
+            if (fd >= 0) ::close(fd);
+            return false;
+        }
+        ::chmod(path.c_str(), 0600);
+        path_ = path;
+        ino_ = st.st_ino;
+        fd_ = fd;
+        running_ = true;
+        server_ = std::thread(&HandoffServer::Serve, this);
+        return true;
     }
-    char* base = (char*)addr;
-    std::memset(base, 0, total_bytes);
-    FrozenHeader hdr{};
-    std::memcpy(hdr.magic, "STRATEGY", 8);
-    hdr.version = 1;
-    hdr.model_cnt = 1;
-    hdr.bucket_cnt = 0;
-    hdr.entry_cnt = 0;
-    hdr.val_pool_sz = (uint32_t)std::min<uint64_t>(UINT32_MAX,
-                     total_bytes - sizeof(FrozenHeader) - sizeof(Model));
-    std::memcpy(base, &hdr, sizeof(hdr));
-    Model m{model_id, model_version};
-    std::memcpy(base + sizeof(FrozenHeader), &m, sizeof(Model));
-    msync(base, total_bytes, MS_SYNC);
-    munmap(addr, total_bytes);
-    ::close(fd);
-    LOG_INFO << "Generated model file: " << path
-             << " size=" << total_bytes
-             << " model=" << model_id << ":" << model_version << std::endl;
-    return true;
-}
+
+    // watch 循环在 promote 后更新, 与交出的表对应
+    void SetServing(const ManifestInfo& m) {
+        std::lock_guard<std::mutex> lk(mu_);
+        serving_ = m;
+    }
+
+    bool Listening() const { return fd_ >= 0; }
+    // 路径仍指向自己的 socket (接任者 bind 后 inode 变化)
+    bool Ours() const {
+        struct stat st{};
+        return fd_ >= 0 && ::stat(path_.c_str(), &st) == 0 && st.st_ino == ino_;
+    }
+    uint64_t Handoffs() const { return handoffs_.load(); }
+
+private:
+    void Serve() {
+        while (running_) {
+            struct pollfd pfd{fd_, POLLIN, 0};
+            if (::poll(&pfd, 1, 200) <= 0) continue;
+            int c = ::accept4(fd_, nullptr, nullptr, SOCK_CLOEXEC);
+            if (c < 0) continue;
+            struct ucred cred{};
+            socklen_t len = sizeof(cred);
+            if (::getsockopt(c, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0 && (cred.uid == getuid() || cred.uid == 0))
+                Send(c, cred.pid);
+            ::close(c);
+        }
+    }
+
+    void Send(int c, pid_t peer) {
+        ManifestInfo m;
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            m = serving_;
+        }
+        auto table = snapshot_.Acquire();   // 发送期间表不会被回收
+        bool memfd = false;
+        int fd = table && !m.target.empty() ? table->Backend()->HandoffFd(&memfd) : -1;
+        if (fd < 0) {
+            LOG_INFO << "[handoff] nothing to hand off to pid=" << peer << std::endl;
+            return;
+        }
+        const std::string text = "HANDOFF kind=" + std::string(memfd ? "memfd" : "file") +
+                                 " version=" + std::to_string(m.version) + "\n" + FormatManifest(m);
+        struct iovec iov{const_cast<char*>(text.data()), text.size()};
+        struct msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        alignas(struct cmsghdr) char ctl[CMSG_SPACE(sizeof(int))] = {};
+        msg.msg_control = ctl;
+        msg.msg_controllen = sizeof(ctl);
+        struct cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+        cm->cmsg_level = SOL_SOCKET;
+        cm->cmsg_type = SCM_RIGHTS;
+        cm->cmsg_len = CMSG_LEN(sizeof(int));
+        std::memcpy(CMSG_DATA(cm), &fd, sizeof(int));
+        if (::sendmsg(c, &msg, MSG_NOSIGNAL) != ssize_t(text.size())) {
+            LOG_ERROR << "[handoff] send fail pid=" << peer << " err=" << std::strerror(errno) << std::endl;
+            return;
+        }
+        ++handoffs_;
+        LOG_INFO << "[handoff] handed " << m.target << " generation=" << m.generation << " kind="
+                 << (memfd ? "memfd" : "file") << " to pid=" << peer << std::endl;
+    }
+
+    TableSnapshot& snapshot_;
+    std::string path_;
+    ino_t ino_{0};
+    int fd_{-1};
+    std::atomic<bool> running_{false};
+    std::thread server_;
+    std::mutex mu_;
+    ManifestInfo serving_;
+    std::atomic<uint64_t> handoffs_{0};
+};
 
 // === 监听 manifest 并热加载 ===
+// 新版本由 StagedLoader 在后台 map/校验/预热, promote 前旧版本持续服务;
+// 切换期间 manifest 再次变化会取消进行中的加载.
+struct WatchOptions {
+    int interval_sec = 5;          // 兜底检查 / 驻留管理周期, 也是轮询退避上限
+    int min_interval_ms = 200;     // 轮询模式发现变化后的最短间隔
+    std::string watch_mode = "auto";
+    StagedLoadOptions load;
+    std::string metrics_file;   // 空 = 不导出
+    std::string reader_id;      // 空 = 不发布租约
+    std::string cache_dir;      // 空 = 不用节点本地缓存
+    uint64_t cache_budget = 0;  // 缓存目录字节预算, 0 = 只受剩余空间限制
+    std::string share_socket;   // 空 = 各进程各自加载
+    std::string handoff_socket; // 空 = 重启时不交接
+    int handoff_wait_sec = 20;  // 退出前等接任进程取表的上限
+};
+
+// 当前快照的分段常驻率 -> 指标, 用于观察内存压力下的常驻衰减
+static void ExportResidency(const TableSnapshot& snapshot) {
+    auto table = snapshot.Acquire();
+    if (!table) return;
+    for (const auto& r : table->SectionResidencies())
+        Metrics::Instance().Set("frozen_table_resident_ratio", r.Ratio(), "section=\"" + r.name + "\"");
+}
+
 static void ManifestWatchLoop(const std::string& manifest,
-                              int interval_sec,
-                              std::atomic<bool>& running) {
-    FrozenHashMapImpl loader;
-    std::string current_target;
-    time_t last_manifest_mtime = 0;
+                              const WatchOptions& opt,
+                              std::atomic<bool>& running,
+                              TableSnapshot& snapshot) {
+    const auto interval = std::chrono::seconds(opt.interval_sec);
+    LocalCache cache;
+    if (!opt.cache_dir.empty() && cache.Open(opt.cache_dir, opt.cache_budget))
+        LOG_INFO << "[cache] dir=" << opt.cache_dir << " budget=" << (opt.cache_budget >> 20) << "MiB" << std::endl;
+    ShareHub hub;
+    if (!opt.share_socket.empty()) {
+        hub.Open(opt.share_socket);
+        if (hub.Enabled() && !hub.Leader()) LOG_INFO << "[share] follower of " << opt.share_socket << std::endl;
+    }
+    StagedLoader loader(snapshot, opt.load, &cache, &hub);
+    PrefetchOptions manage_prefetch = opt.load.prefetch;
+    manage_prefetch.progress = nullptr;
+    ResidencyManager residency(opt.load.residency_budget, manage_prefetch);
+    auto watcher = MakeManifestWatcher(manifest, opt.watch_mode,
+                                       std::chrono::milliseconds(opt.min_interval_ms), interval);
+    LOG_INFO << "Manifest watcher=" << watcher->name() << std::endl;
+    ReaderLease lease;
+    if (!opt.reader_id.empty() && lease.Open(LeaseDir(BaseFromManifest(manifest)), opt.reader_id))
+        LOG_INFO << "[lease] reader=" << opt.reader_id << std::endl;
+    ManifestInfo current;   // 最新请求的版本
+    ManifestInfo serving;   // 已 promote 的版本
+    struct timespec last_manifest_mtime{};
     time_t last_target_mtime = 0;
+    double pending_publish = 0;   // 进行中切换的发布时间, 用于端到端传播延迟
+    auto next_housekeeping = std::chrono::steady_clock::now();
+
+    // 先向前任进程取已常驻的表, 再接管 socket 名字
+    HandoffServer handoff(snapshot);
+    if (!opt.handoff_socket.empty()) {
+        int fd = -1;
+        bool memfd = false;
+        ManifestInfo m;
+        if (HandoffServer::Receive(opt.handoff_socket, &m, &fd, &memfd)) {
+            LOG_INFO << "[handoff] adopting " << m.target << " generation=" << m.generation
+                     << " kind=" << (memfd ? "memfd" : "file") << std::endl;
+            struct stat stt{};
+            time_t mtime = m.version < 2 && stat(m.target.c_str(), &stt) == 0 ? stt.st_mtime : 0;
+            current = m;
+            lease.Update(serving.generation, serving.target, current.target);
+            loader.Adopt(current, mtime, fd, memfd);
+        }
+        if (handoff.Listen(opt.handoff_socket)) LOG_INFO << "[handoff] listening " << opt.handoff_socket << std::endl;
+    }
+
+    // 取走已 promote 的版本: serving 记为 loader 实际发布的 manifest (不是此刻的 current).
+    // 每次 Start 前先调用, 否则新的加载启动后这次 promote 不会登记到租约 / 交接
+    auto take_loaded = [&] {
+        ManifestInfo loaded;
+        time_t loaded_mtime = 0;
+        if (!loader.TakeLoaded(&loaded, &loaded_mtime)) return;
+        last_target_mtime = loaded_mtime;
+        serving = loaded;
+        handoff.SetServing(serving);
+        lease.Update(serving.generation, serving.target, serving.target == current.target ? "" : current.target);
+        cache.Retain({LocalCache::Key(serving), LocalCache::Key(current)});
+        hub.Retain({LocalCache::Key(serving), LocalCache::Key(current)});
+        if (pending_publish > 0 && serving.target == current.target) {
+            // manifest 发布 -> 新版本可服务
+            Metrics::Instance().Set("frozen_version_propagation_seconds",
+                                    std::max(0.0, WallSeconds() - pending_publish));
+            pending_publish = 0;
+        }
+    };
 
     while (running) {
+        bool changed = false;
         struct stat stm{};
         if (stat(manifest.c_str(), &stm) == 0) {
-            if (stm.st_mtime != last_manifest_mtime) {
-                last_manifest_mtime = stm.st_mtime;
-                std::string new_target;
-                if (ReadManifest(manifest, &new_target) && !new_target.empty()) {
-                    if (new_target != current_target) {
-                        LOG_INFO << "Manifest switch -> " << new_target << std::endl;
-                        current_target = new_target;
-                        if (FileExistsNonEmpty(current_target)) {
-                            if (loader.Build(current_target)) {
-                                struct stat stt{};
-                                if (stat(current_target.c_str(), &stt) == 0)
-                                    last_target_mtime = stt.st_mtime;
-                            }
+            if (stm.st_mtim.tv_sec != last_manifest_mtime.tv_sec || stm.st_mtim.tv_nsec != last_manifest_mtime.tv_nsec) {
+                last_manifest_mtime = stm.st_mtim;
+                ManifestInfo m;
+                if (ReadManifest(manifest, &m)) {
+                    // v2 以 generation 判定; v1 只能比较路径
+                    bool fresh = m.target != current.target ||
+                                 (m.version >= 2 && m.generation != current.generation);
+                    if (fresh && m.version >= 2 && current.version >= 2 && m.generation < current.generation) {
+                        LOG_ERROR << "Stale manifest generation " << m.generation << " < "
+                                  << current.generation << ", ignored" << std::endl;
+                        fresh = false;
+                    }
+                    if (fresh) {
+                        changed = true;
+                        double published = m.published_at_ns ? m.published_at_ns / 1e9 : MtimeSeconds(stm);
+                        double detect = std::max(0.0, WallSeconds() - published);
+                        Metrics::Instance().Set("frozen_manifest_detect_seconds", detect);
+                        Metrics::Instance().Set("frozen_manifest_generation", double(m.generation));
+                        LOG_INFO << "Manifest switch -> " << m.target << " generation=" << m.generation
+                                 << " detect=" << detect << "s" << std::endl;
+                        take_loaded();
+                        current = m;
+                        lease.Update(serving.generation, serving.target, current.target);
+                        if (m.version >= 2) {
+                            // size / sections 在 validate 阶段对照, 这里不 stat 目标
+                            loader.Start(current, 0);
+                            pending_publish = published;
                         } else {
-                            LOG_ERROR << "Target not ready: " << current_target << std::endl;
+                            struct stat stt{};
+                            if (FileExistsNonEmpty(current.target) && stat(current.target.c_str(), &stt) == 0) {
+                                loader.Start(current, stt.st_mtime);
+                                pending_publish = published;
+                            } else {
+                                LOG_ERROR << "Target not ready: " << current.target << std::endl;
+                            }
                         }
                     }
                 }
@@ -271,21 +5009,102 @@ static void ManifestWatchLoop(const std::string& manifest,
         } else {
             LOG_ERROR << "stat manifest fail: " << manifest << std::endl;
         }
-        if (!current_target.empty()) {
-            struct stat stt{};
-            if (stat(current_target.c_str(), &stt) == 0) {
-                if (stt.st_mtime != last_target_mtime) {
-                    LOG_INFO << "Detected target update: " << current_target << std::endl;
-                    if (loader.Build(current_target)) last_target_mtime = stt.st_mtime;
+        take_loaded();
+        // 目标 mtime 检查与驻留管理按 interval 做, 不随通知频率放大元数据调用
+        auto now = std::chrono::steady_clock::now();
+        if (now >= next_housekeeping) {
+            next_housekeeping = now + interval;
+            // v1 manifest 无 generation, 仍需靠目标 mtime 发现原地重写
+            take_loaded();
+            if (current.version < 2 && !current.target.empty() && loader.Idle()) {
+                struct stat stt{};
+                if (stat(current.target.c_str(), &stt) == 0) {
+                    if (stt.st_mtime != last_target_mtime) {
+                        LOG_INFO << "Detected target update: " << current.target << std::endl;
+                        loader.Start(current, stt.st_mtime);
+                    }
                 }
             }
+            snapshot.Reclaim();
+            lease.Heartbeat();
+            cache.Retain({LocalCache::Key(serving), LocalCache::Key(current)});
+            hub.Retain({LocalCache::Key(serving), LocalCache::Key(current)});
+            hub.TryElect();
+            residency.Tick(snapshot);
+            ExportResidency(snapshot);
+            FileAccess::ExportMetrics();
+            if (!opt.metrics_file.empty()) AtomicWriteFile(opt.metrics_file, Metrics::Instance().Render());
         }
-        for (int i = 0; i < interval_sec * 10 && running; ++i)
+        watcher->OnChecked(changed);
+        // 加载进行中时缩短等待, 尽快 TakeLoaded 并记录传播延迟
+        auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(next_housekeeping - std::chrono::steady_clock::now());
+        if (loader.Busy()) wait = std::min(wait, std::chrono::milliseconds(opt.min_interval_ms));
+        watcher->Wait(std::max(wait, std::chrono::milliseconds(1)), running);
+    }
+
+    // 停止: 取消进行中的加载; 没有接任者占用 socket 时继续持有表与租约, 等新进程来取
+    loader.Stop();
+    if (handoff.Ours() && snapshot.Acquire()) {
+        const uint64_t before = handoff.Handoffs();
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(opt.handoff_wait_sec);
+        LOG_INFO << "[handoff] draining, waiting up to " << opt.handoff_wait_sec << "s for a successor" << std::endl;
+        while (handoff.Ours() && handoff.Handoffs() == before && std::chrono::steady_clock::now() < deadline)
             std::this_thread::sleep_for(std::chrono::milliseconds(100));
     }
+    LOG_INFO << "Watch stopped generation=" << serving.generation << " target=" << serving.target << std::endl;
+}
+
+// === 旧版本回收 ===
+// 候选: <base>_g<数字>. 保留: 最新 retain 个已发布版本 (未发布的预构建版本 generation 更大,
+// 天然保留)、存活租约引用的目标、pinned (在途 delta 的参照版本), 以及这些容器所引用的段文件;
+// 另外 mtime 在租约超时内的文件也不删 (覆盖尚未刷新租约的 reader 与待 Reclaim 的旧映射).
+static void CollectUnleasedVersions(const std::string& base, uint64_t published, int retain, int lease_timeout_sec,
+                                    const std::vector<std::string>& pinned = {}) {
+    const std::string dir = DirOf(base);
+    const std::string prefix = BaseName(base) + "_g";
+    std::vector<std::pair<uint64_t, std::string>> versions;
+    DIR* d = opendir(dir.c_str());
+    if (!d) return;
+    while (struct dirent* e = readdir(d)) {
+        std::string name = e->d_name;
+        if (name.size() <= prefix.size() || name.compare(0, prefix.size(), prefix) != 0 ||
+            name.find_first_not_of("0123456789", prefix.size()) != std::string::npos)
+            continue;
+        versions.emplace_back(std::strtoull(name.c_str() + prefix.size(), nullptr, 10), dir + "/" + name);
+    }
+    closedir(d);
+
+    std::vector<std::string> roots = pinned;
+    for (const auto& r : LiveLeases(LeaseDir(base), lease_timeout_sec)) {
+        roots.push_back(r.target);
+        roots.push_back(r.loading);
+    }
+    for (const auto& v : versions)
+        if (v.first + uint64_t(retain) > published) roots.push_back(v.second);
+    std::set<std::string> held;
+    for (const auto& r : roots) {
+        if (r.empty() || !held.insert(r).second) continue;
+        SegmentTable t;
+        if (IsSegmentedFile(r) && ReadSegmentTable(r, &t)) held.insert(t.files.begin(), t.files.end());
+    }
+
+    const time_t now = time(nullptr);
+    for (const auto& v : versions) {
+        const std::string& path = v.second;
+        if (held.count(path)) continue;
+        struct stat st{};
+        if (stat(path.c_str(), &st) != 0 || now - st.st_mtime < lease_timeout_sec) continue;
+        if (unlink(path.c_str()) == 0)
+            LOG_INFO << "[gc] removed unleased version " << path << std::endl;
+        else
+            LOG_ERROR << "[gc] unlink fail: " << path << " err=" << std::strerror(errno) << std::endl;
+    }
 }
 
 // === Writer 循环：生成 N 个版本并滚动 manifest ===
+// 每个 generation 写入新文件 <base>_g<generation>, 从不覆盖 reader 可能仍在映射的文件.
+// 最多 WRITER_CONCURRENCY 个版本并行生成 (滑动窗口), 按 generation 顺序发布,
+// 相邻两次发布至少间隔 VERSION_UPDATE_INTERVAL_SEC; 每次发布后按保留策略回收.
 static int WriterLoop() {
     std::string base = GetEnvOrDefault("MODEL_BASE", "/mnt/blobfuse/frozen_kv");
     uint64_t size_bytes = std::strtoull(
@@ -293,39 +5112,535 @@ static int WriterLoop() {
     int version_cnt = std::atoi(GetEnvOrDefault("VERSION_COUNT","5").c_str());
     int interval_sec = std::atoi(GetEnvOrDefault("VERSION_UPDATE_INTERVAL_SEC","5").c_str());
     int cycles = std::atoi(GetEnvOrDefault("CYCLES","0").c_str()); // 0 = infinite
+    int lease_timeout = std::max(1, std::atoi(GetEnvOrDefault("LEASE_TIMEOUT_SEC","60").c_str()));
+    int concurrency = std::max(1, std::atoi(GetEnvOrDefault("WRITER_CONCURRENCY","1").c_str()));
+    int retain = std::max(1, std::atoi(GetEnvOrDefault("RETAIN_VERSIONS","2").c_str()));
+    StreamWriteOptions wopt;
+    wopt.block_bytes =
+        std::max<uint64_t>(1, std::strtoull(GetEnvOrDefault("WRITE_BLOCK_MB","8").c_str(), nullptr, 10)) << 20;
+    wopt.direct = GetEnvOrDefault("WRITE_DIRECT","0") == "1";
+    wopt.sum_chunk = std::strtoull(GetEnvOrDefault("SUM_CHUNK_MB","8").c_str(), nullptr, 10) << 20;
+    DeltaOptions delta;
+    delta.segment_bytes =
+        std::strtoull(GetEnvOrDefault("DELTA_SEGMENT_MB","0").c_str(), nullptr, 10) << 20;
+    delta.max_files = (uint32_t)std::max(2, std::atoi(GetEnvOrDefault("DELTA_MAX_FILES","8").c_str()));
 
     if (version_cnt <= 0) version_cnt = 5;
     LOG_INFO << "WriterLoop start base=" << base
              << " size=" << size_bytes
              << " versions=" << version_cnt
              << " interval=" << interval_sec
-             << " cycles=" << cycles << std::endl;
+             << " cycles=" << cycles
+             << " concurrency=" << concurrency
+             << " retain=" << retain << std::endl;
 
     const std::string manifest = base + ".manifest";
-    int cycle = 0;
-    while (cycles == 0 || cycle < cycles) {
-        for (int v = 1; v <= version_cnt; ++v) {
-            std::ostringstream fname;
-            fname << base << "_v" << v;
-            // 简单生成（重写覆盖触发 mtime）
-            if (!GenerateBigModelFile(fname.str(), size_bytes, 1000 + v, v)) {
-                LOG_ERROR << "Generate file failed, abort." << std::endl;
-                return EXIT_FAILURE;
-            }
-            if (!WriteManifest(manifest, fname.str())) {
-                LOG_ERROR << "Write manifest failed" << std::endl;
-                return EXIT_FAILURE;
-            }
-            LOG_INFO << "Manifest -> " << fname.str() << std::endl;
-            std::this_thread::sleep_for(std::chrono::seconds(interval_sec));
+    // generation 跨 writer 重启单调: 从已有 manifest 续号
+    uint64_t published = 0;
+    std::string published_target;   // delta 参照
+    {
+        ManifestInfo prev;
+        if (ReadManifest(manifest, &prev)) {
+            published = prev.generation;
+            published_target = prev.target;
+        }
+    }
+    const uint64_t total = cycles == 0 ? UINT64_MAX : uint64_t(cycles) * version_cnt;
+
+    struct Job {
+        ManifestInfo info;
+        std::string delta_base;
+        std::future<bool> done;
+    };
+    std::deque<Job> window;
+    uint64_t next_gen = published + 1;
+    uint64_t launched = 0;
+    auto last_publish = std::chrono::steady_clock::time_point{};
+    while (launched < total || !window.empty()) {
+        // 补满窗口: 版本号 v 在 1..VERSION_COUNT 间轮转
+        while (launched < total && window.size() < size_t(concurrency)) {
+            int v = int(launched % version_cnt) + 1;
+            window.emplace_back();
+            Job& job = window.back();
+            job.info.generation = next_gen++;
+            std::string path = base + "_g" + std::to_string(job.info.generation);
+            ManifestInfo* info = &job.info;
+            DeltaOptions jd = delta;
+            jd.base = job.delta_base = published_target;
+            job.done = std::async(std::launch::async, [path, v, size_bytes, info, wopt, jd] {
+                return GenerateBigModelFile(path, size_bytes, 1000 + v, v, info, wopt, jd);
+            });
+            ++launched;
+        }
+        Job& head = window.front();
+        if (!head.done.get()) {
+            LOG_ERROR << "Generate file failed, abort." << std::endl;
+            for (auto& j : window) if (j.done.valid()) j.done.wait();
+            return EXIT_FAILURE;
         }
-        ++cycle;
+        auto due = last_publish + std::chrono::seconds(interval_sec);
+        if (published && std::chrono::steady_clock::now() < due) std::this_thread::sleep_until(due);
+        ManifestInfo& info = head.info;
+        info.version = 2;
+        info.published_at_ns = WallNanos();
+        if (!WriteManifest(manifest, info)) {
+            LOG_ERROR << "Write manifest failed" << std::endl;
+            for (auto& j : window) if (j.done.valid()) j.done.wait();
+            return EXIT_FAILURE;
+        }
+        last_publish = std::chrono::steady_clock::now();
+        published = info.generation;
+        published_target = info.target;
+        LOG_INFO << "Manifest -> " << info.target << " generation=" << published
+                 << " in_flight=" << window.size() - 1 << std::endl;
+        window.pop_front();
+        std::vector<std::string> pinned;
+        for (const auto& j : window) pinned.push_back(j.delta_base);
+        CollectUnleasedVersions(base, published, retain, lease_timeout, pinned);
     }
     return EXIT_SUCCESS;
 }
 
+// === 查询服务 (serve) ===
+// Unix socket 二进制协议 (小端). 客户端可连续发多个请求 (流水线), 响应带回 req_id, 不保证顺序:
+//   请求: u32 len | u32 req_id | u16 op (1 = GET) | u16 n | n × (u16 klen | key)
+//   响应: u32 len | u32 req_id | u16 status | u16 n | n × (u32 vlen | value), vlen = 0xFFFFFFFF 表示未命中
+// len 不含自身 4 字节. status: 0 = OK, 1 = 请求格式错误, 2 = 尚无已加载的表.
+// 一个 IO 线程 (epoll) 收包切帧, 一次可读事件里收齐的请求 (至多 batch 个) 合成一批, 轮流投进各
+// worker 的队列; worker 每核一个, 自己队列空了就从别的队列尾部偷批. 每批在一个 ReadGuard 内用
+// 一次 MultiGet 查完并一次写回, 热切换只影响下一批, 已收到的请求照常用旧表答完.
+// socket 为 0600, 只应答同 uid (或 root) 的对端; 路径由 <socket>.lock 上的 flock 归属, 不顶替存活的 serve.
+// worker 不阻塞在写上: 写不完的响应留在连接的输出缓冲, 由 IO 线程等 EPOLLOUT 续写; 某连接排队的
+// 请求与未写出的响应超过 max_buffered 时暂停读它, 由对端的 socket 缓冲反压.
+struct ServeOptions {
+    std::string socket;
+    uint32_t threads = 4;
+    uint32_t batch = 64;                     // 每批最多请求数
+    uint32_t max_frame = 16u << 20;          // 超过即视为协议错误, 断开连接
+    uint64_t max_buffered = 64ull << 20;     // 每连接排队请求 + 未写出响应, 超过即暂停读取
+    bool wait_socket = false;                // 前任 serve 仍持有 socket 时等它退出 (重启交接), 否则启动失败
+};
+
+class LookupServer {
+public:
+    static constexpr uint16_t kOpGet = 1;
+    static constexpr uint16_t kStatusOk = 0, kStatusBadRequest = 1, kStatusNoTable = 2;
+    static constexpr uint32_t kMiss = 0xFFFFFFFFu;
+
+    LookupServer(TableSnapshot& snapshot, const ServeOptions& opt) : snapshot_(snapshot), opt_(opt) {}
+    ~LookupServer() { Stop(); }
+
+    bool Start() {
+        if (opt_.socket.size() >= sizeof(sockaddr_un::sun_path)) {
+            LOG_ERROR << "[serve] socket path too long: " << opt_.socket << std::endl;
+            return false;
+        }
+        lock_fd_ = ::open((opt_.socket + ".lock").c_str(), O_CREAT | O_RDWR | O_CLOEXEC, 0600);
+        epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+        if (lock_fd_ < 0 || epoll_fd_ < 0) {
+            LOG_ERROR << "[serve] open fail: " << opt_.socket << ".lock err=" << std::strerror(errno) << std::endl;
+            return false;
+        }
+        if (!TryListen()) {
+            if (listen_fd_ == -2) return false;
+            if (!opt_.wait_socket) {
+                LOG_ERROR << "[serve] " << opt_.socket << " is held by another serve process" << std::endl;
+                return false;
+            }
+            LOG_INFO << "[serve] " << opt_.socket << " held by predecessor, listening once it exits" << std::endl;
+        }
+        running_ = true;
+        queues_ = std::vector<Queue>(std::max(1u, opt_.threads));
+        for (uint32_t i = 0; i < queues_.size(); ++i) workers_.emplace_back(&LookupServer::Work, this, i);
+        io_ = std::thread(&LookupServer::Io, this);
+        return true;
+    }
+
+    void Stop() {
+        if (running_.exchange(false)) {
+            cv_.notify_all();
+            io_.join();
+            for (auto& w : workers_) w.join();
+            workers_.clear();
+            conns_.clear();
+            draining_.clear();
+            if (listen_fd_ >= 0) ::unlink(opt_.socket.c_str());   // 持有 flock 时路径必属于本进程
+            LOG_INFO << "[serve] stopped requests=" << requests_.load() << " keys=" << keys_.load()
+                     << " steals=" << steals_.load() << " paused=" << paused_.load() << std::endl;
+        }
+        if (epoll_fd_ >= 0) ::close(epoll_fd_);
+        if (listen_fd_ >= 0) ::close(listen_fd_);
+        if (lock_fd_ >= 0) ::close(lock_fd_);   // 释放 flock, 等待中的接任者随后 bind
+        epoll_fd_ = listen_fd_ = lock_fd_ = -1;
+    }
+
+private:
+    struct Conn {
+        explicit Conn(int f) : fd(f) {}
+        ~Conn() { ::close(fd); }
+        int fd;
+        std::string in;                  // 未切完的字节 (仅 IO 线程)
+        std::mutex mu;                   // 保护以下字段
+        std::string out;                 // 未写出的响应
+        uint64_t queued = 0;             // 已投递未处理的请求字节
+        uint32_t inflight = 0;           // 已投递未处理的批次
+        bool reading = true;             // 对端尚未半关闭
+        uint32_t armed = EPOLLIN | EPOLLRDHUP;
+        std::atomic<bool> closed{false};
+    };
+    struct Batch {
+        std::shared_ptr<Conn> conn;
+        std::string frames;              // 若干完整请求帧 (含 len 前缀)
+        uint32_t count = 0;
+    };
+    struct Queue {
+        std::mutex mu;
+        std::deque<Batch> q;
+    };
+
+    template <typename T>
+    static T Load(const char* p) {
+        T v;
+        std::memcpy(&v, p, sizeof(T));
+        return v;
+    }
+    template <typename T>
+    static void Append(std::string* out, T v) {
+        out->append(reinterpret_cast<const char*>(&v), sizeof(T));
+    }
+
+    // 持有 <socket>.lock 才 bind: 残留的 socket 文件属于已退出的 serve. 锁被占用时 listen_fd_ 保持 -1,
+    // 锁已拿到但 bind 失败时置 -2
+    bool TryListen() {
+        if (flock(lock_fd_, LOCK_EX | LOCK_NB) != 0) return false;
+        struct sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, opt_.socket.c_str(), opt_.socket.size());
+        ::unlink(opt_.socket.c_str());
+        int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        struct epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (fd < 0 || ::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            ::chmod(opt_.socket.c_str(), 0600) != 0 || ::listen(fd, 512) != 0 ||
+            ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            LOG_ERROR << "[serve] listen fail: " << opt_.socket << " err=" << std::strerror(errno) << std::endl;
+            if (fd >= 0) ::close(fd);
+            flock(lock_fd_, LOCK_UN);
+            listen_fd_ = -2;
+            return false;
+        }
+        listen_fd_ = fd;
+        LOG_INFO << "[serve] listening " << opt_.socket << " workers=" << std::max(1u, opt_.threads)
+                 << " batch=" << opt_.batch << std::endl;
+        return true;
+    }
+
+    void Io() {
+        struct epoll_event events[64];
+        uint32_t next_queue = 0;
+        auto next_export = std::chrono::steady_clock::now();
+        while (running_) {
+            if (listen_fd_ == -1) TryListen();   // 等前任释放; bind 失败 (-2) 已记日志, 不再重试
+            int n = ::epoll_wait(epoll_fd_, events, 64, 200);
+            for (int i = 0; i < n; ++i) {
+                if (events[i].data.fd == listen_fd_) {
+                    Accept();
+                    continue;
+                }
+                auto it = conns_.find(events[i].data.fd);
+                if (it == conns_.end()) continue;
+                std::shared_ptr<Conn> conn = it->second;
+                if (events[i].events & (EPOLLERR | EPOLLHUP)) conn->closed = true;
+                if (events[i].events & EPOLLOUT) {
+                    std::lock_guard<std::mutex> lk(conn->mu);
+                    Flush(conn.get());
+                    Arm(conn.get());
+                }
+                if (conn->closed) {
+                    Drop(it);
+                    continue;
+                }
+                if (!(events[i].events & (EPOLLIN | EPOLLRDHUP))) continue;
+                bool open = Read(conn.get(), opt_.max_buffered);
+                bool broken = false;
+                // 切帧: 每满 batch 个请求投递一批, 余下的作为最后一批
+                Batch b;
+                size_t off = 0;
+                while (conn->in.size() - off >= 4) {
+                    uint32_t len = Load<uint32_t>(conn->in.data() + off);
+                    if (len < 8 || len > opt_.max_frame) {
+                        LOG_ERROR << "[serve] bad frame len=" << len << ", closing fd=" << conn->fd << std::endl;
+                        open = false;
+                        broken = true;
+                        break;
+                    }
+                    if (conn->in.size() - off < 4 + len) break;
+                    b.frames.append(conn->in, off, 4 + len);
+                    off += 4 + len;
+                    if (++b.count == opt_.batch) {
+                        Dispatch(conn, std::move(b), &next_queue);
+                        b = Batch();
+                    }
+                }
+                conn->in.erase(0, off);
+                if (b.count) Dispatch(conn, std::move(b), &next_queue);
+                if (broken) {
+                    conn->closed = true;
+                    Drop(it);
+                    continue;
+                }
+                std::lock_guard<std::mutex> lk(conn->mu);
+                if (!open) {
+                    // 对端半关闭: 不再读, 在途批次照常写回, 写完后由下面的巡检关闭
+                    conn->reading = false;
+                    draining_.insert(conn->fd);
+                }
+                Arm(conn.get());
+            }
+            for (auto d = draining_.begin(); d != draining_.end();) {
+                auto it = conns_.find(*d);
+                bool done = it == conns_.end() || it->second->closed;
+                if (!done) {
+                    std::lock_guard<std::mutex> lk(it->second->mu);
+                    done = it->second->inflight == 0 && it->second->out.empty();
+                }
+                if (!done) {
+                    ++d;
+                    continue;
+                }
+                d = draining_.erase(d);
+                if (it != conns_.end()) Drop(it);
+            }
+            auto now = std::chrono::steady_clock::now();
+            if (now >= next_export) {
+                next_export = now + std::chrono::seconds(1);
+                Metrics::Instance().Set("frozen_serve_requests", double(requests_.load()));
+                Metrics::Instance().Set("frozen_serve_keys", double(keys_.load()));
+                Metrics::Instance().Set("frozen_serve_steals", double(steals_.load()));
+                Metrics::Instance().Set("frozen_serve_connections", double(conns_.size()));
+                Metrics::Instance().Set("frozen_serve_paused", double(paused_.load()));
+            }
+        }
+    }
+
+    // 移出 epoll 与连接表; 在途批次持有 shared_ptr, 最后一个释放时关 fd
+    void Drop(std::map<int, std::shared_ptr<Conn>>::iterator it) {
+        it->second->closed = true;
+        ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, it->first, nullptr);
+        draining_.erase(it->first);
+        conns_.erase(it);
+    }
+
+    void Accept() {
+        for (;;) {
+            int fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) return;
+            struct ucred cred{};
+            socklen_t len = sizeof(cred);
+            if (::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0 || (cred.uid != getuid() && cred.uid != 0)) {
+                LOG_ERROR << "[serve] rejected peer pid=" << cred.pid << " uid=" << cred.uid << std::endl;
+                ::close(fd);
+                continue;
+            }
+            struct epoll_event ev{};
+            ev.events = EPOLLIN | EPOLLRDHUP;
+            ev.data.fd = fd;
+            if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) != 0) {
+                ::close(fd);
+                continue;
+            }
+            conns_[fd] = std::make_shared<Conn>(fd);
+        }
+    }
+
+    // 读到 EAGAIN 或缓冲达到 cap (水平触发, 余下的下次再读); 对端关闭或出错返回 false
+    static bool Read(Conn* c, uint64_t cap) {
+        char buf[64 << 10];
+        while (c->in.size() < cap) {
+            ssize_t r = ::recv(c->fd, buf, sizeof(buf), 0);
+            if (r > 0) {
+                c->in.append(buf, r);
+                continue;
+            }
+            if (r < 0 && errno == EINTR) continue;
+            return r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+        }
+        return true;
+    }
+
+    // 按连接状态更新 epoll 关注的事件 (持 c->mu 调用): 有未写出的响应关注 EPOLLOUT,
+    // 排队请求 + 未写出响应超过 max_buffered 时不再关注 EPOLLIN
+    void Arm(Conn* c) {
+        const bool paused = c->queued + c->out.size() > opt_.max_buffered;
+        uint32_t want = (c->reading && !paused ? uint32_t(EPOLLIN | EPOLLRDHUP) : 0u) | (c->out.empty() ? 0u : uint32_t(EPOLLOUT));
+        if (want == c->armed || c->closed) return;
+        if (c->reading && paused && (c->armed & EPOLLIN)) paused_.fetch_add(1, std::memory_order_relaxed);
+        struct epoll_event ev{};
+        ev.events = want;
+        ev.data.fd = c->fd;
+        ::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, c->fd, &ev);
+        c->armed = want;
+    }
+
+    // 非阻塞写出 c->out, 写不动的留给 EPOLLOUT (持 c->mu 调用)
+    static void Flush(Conn* c) {
+        size_t put = 0;
+        while (put < c->out.size() && !c->closed) {
+            ssize_t w = ::send(c->fd, c->out.data() + put, c->out.size() - put, MSG_NOSIGNAL);
+            if (w > 0) {
+                put += w;
+                continue;
+            }
+            if (w < 0 && errno == EINTR) continue;
+            if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            c->closed = true;
+        }
+        c->out.erase(0, put);
+    }
+
+    void Dispatch(const std::shared_ptr<Conn>& conn, Batch&& b, uint32_t* next_queue) {
+        {
+            std::lock_guard<std::mutex> lk(conn->mu);
+            conn->queued += b.frames.size();
+            ++conn->inflight;
+        }
+        b.conn = conn;
+        Queue& q = queues_[(*next_queue)++ % queues_.size()];
+        {
+            std::lock_guard<std::mutex> lk(q.mu);
+            q.q.push_back(std::move(b));
+        }
+        pending_.fetch_add(1);
+        cv_.notify_one();
+    }
+
+    // 先取自己队列头部, 空了再从其他队列尾部偷
+    bool Take(uint32_t self, Batch* out) {
+        for (size_t k = 0; k < queues_.size(); ++k) {
+            Queue& q = queues_[(self + k) % queues_.size()];
+            std::lock_guard<std::mutex> lk(q.mu);
+            if (q.q.empty()) continue;
+            if (k == 0) {
+                *out = std::move(q.q.front());
+                q.q.pop_front();
+            } else {
+                *out = std::move(q.q.back());
+                q.q.pop_back();
+                steals_.fetch_add(1, std::memory_order_relaxed);
+            }
+            pending_.fetch_sub(1);
+            return true;
+        }
+        return false;
+    }
+
+    void Work(uint32_t self) {
+        std::vector<std::string_view> keys, vals;
+        std::vector<uint32_t> key_begin;
+        std::string out;
+        Batch b;
+        while (running_) {
+            if (!Take(self, &b)) {
+                std::unique_lock<std::mutex> lk(cv_mu_);
+                cv_.wait_for(lk, std::chrono::milliseconds(100), [&] { return pending_.load() > 0 || !running_; });
+                continue;
+            }
+            if (!b.conn->closed) Process(b, &keys, &vals, &key_begin, &out);
+            Write(b, out);
+            b = Batch();
+        }
+    }
+
+    // 整批 key 一次 MultiGet, 响应按请求顺序拼成一个缓冲
+    void Process(const Batch& b, std::vector<std::string_view>* keys, std::vector<std::string_view>* vals,
+                 std::vector<uint32_t>* key_begin, std::string* out) {
+        keys->clear();
+        key_begin->clear();
+        out->clear();
+        std::vector<bool> bad(b.count, false);
+        const char* p = b.frames.data();
+        for (uint32_t r = 0; r < b.count; ++r) {
+            const uint32_t len = Load<uint32_t>(p);
+            const char* q = p + 12;
+            const char* fend = p + 4 + len;
+            const uint16_t op = Load<uint16_t>(p + 8), n = Load<uint16_t>(p + 10);
+            key_begin->push_back((uint32_t)keys->size());
+            bad[r] = op != kOpGet;
+            for (uint16_t i = 0; i < n && !bad[r]; ++i) {
+                if (fend - q < 2 || fend - q - 2 < Load<uint16_t>(q)) {
+                    bad[r] = true;
+                    break;
+                }
+                uint16_t klen = Load<uint16_t>(q);
+                keys->emplace_back(q + 2, klen);
+                q += 2 + klen;
+            }
+            if (bad[r]) keys->resize(key_begin->back());
+            p = fend;
+        }
+        key_begin->push_back((uint32_t)keys->size());
+
+        vals->assign(keys->size(), std::string_view());
+        auto table = snapshot_.Acquire();
+        if (table && !keys->empty()) table->MultiGet(keys->data(), keys->size(), vals->data());
+
+        p = b.frames.data();
+        for (uint32_t r = 0; r < b.count; ++r) {
+            const uint32_t req_id = Load<uint32_t>(p + 4);
+            p += 4 + Load<uint32_t>(p);
+            const uint32_t k0 = (*key_begin)[r], k1 = (*key_begin)[r + 1];
+            const uint16_t status = bad[r] ? kStatusBadRequest : (table ? kStatusOk : kStatusNoTable);
+            const uint16_t n = status == kStatusOk ? uint16_t(k1 - k0) : 0;
+            const size_t at = out->size();
+            Append<uint32_t>(out, 0);
+            Append<uint32_t>(out, req_id);
+            Append<uint16_t>(out, status);
+            Append<uint16_t>(out, n);
+            for (uint32_t i = k0; i < k0 + n; ++i) {
+                const std::string_view& v = (*vals)[i];
+                Append<uint32_t>(out, v.data() ? uint32_t(v.size()) : kMiss);
+                out->append(v.data() ? v.data() : "", v.size());
+            }
+            const uint32_t len = uint32_t(out->size() - at - 4);
+            std::memcpy(&(*out)[at], &len, 4);
+        }
+        requests_.fetch_add(b.count, std::memory_order_relaxed);
+        keys_.fetch_add(keys->size(), std::memory_order_relaxed);
+    }
+
+    // 响应追加到连接的输出缓冲并尽量写出, 不等对端; 写不完的由 IO 线程按 EPOLLOUT 续写
+    void Write(const Batch& b, const std::string& buf) {
+        Conn* c = b.conn.get();
+        std::lock_guard<std::mutex> lk(c->mu);
+        c->queued -= b.frames.size();
+        --c->inflight;
+        if (c->closed) return;
+        c->out.append(buf);
+        Flush(c);
+        Arm(c);
+    }
+
+    TableSnapshot& snapshot_;
+    ServeOptions opt_;
+    int lock_fd_{-1};
+    int listen_fd_{-1};
+    int epoll_fd_{-1};
+    std::atomic<bool> running_{false};
+    std::thread io_;
+    std::vector<std::thread> workers_;
+    std::vector<Queue> queues_;
+    std::map<int, std::shared_ptr<Conn>> conns_;   // 仅 IO 线程
+    std::set<int> draining_;                       // 已半关闭, 等在途响应写完 (仅 IO 线程)
+    std::mutex cv_mu_;
+    std::condition_variable cv_;
+    std::atomic<uint64_t> pending_{0};
+    std::atomic<uint64_t> requests_{0}, keys_{0}, steals_{0}, paused_{0};
+};
+
 // === Reader Watch ===
-static int ReaderWatch(const std::string& manifest, int interval_sec) {
+// serve_socket 非空时同时在该 socket 上提供查询 (serve 模式)
+static int ReaderWatch(const std::string& manifest, int interval_sec, const std::string& serve_socket = "") {
     if (!FileExistsNonEmpty(manifest)) {
         LOG_INFO << "Waiting manifest: " << manifest << std::endl;
         int wait = 0;
@@ -338,20 +5653,69 @@ static int ReaderWatch(const std::string& manifest, int interval_sec) {
             return EXIT_FAILURE;
         }
     }
-    std::atomic<bool> running(true);
-    signal(SIGINT, [](int){});
+    // SIGTERM / SIGINT 只置标志, watch 循环在下一个等待片段内退出并完成交接 / 释放租约
+    static std::atomic<bool> running(true);
+    signal(SIGTERM, [](int) { running = false; });
+    signal(SIGINT, [](int) { running = false; });
     LOG_INFO << "Start watch manifest=" << manifest
              << " interval=" << interval_sec << "s" << std::endl;
-    ManifestWatchLoop(manifest, interval_sec, running);
+    WatchOptions opt;
+    opt.interval_sec = interval_sec;
+    opt.min_interval_ms = std::max(10, std::atoi(GetEnvOrDefault("WATCH_MIN_INTERVAL_MS", "200").c_str()));
+    opt.watch_mode = GetEnvOrDefault("WATCH_MODE", "auto");
+    opt.metrics_file = GetEnvOrDefault("METRICS_FILE", "");
+    opt.cache_dir = GetEnvOrDefault("LOCAL_CACHE_DIR", "");
+    opt.cache_budget = std::strtoull(GetEnvOrDefault("LOCAL_CACHE_MB", "0").c_str(), nullptr, 10) << 20;
+    opt.share_socket = GetEnvOrDefault("SHARE_SOCKET", "");
+    opt.handoff_socket = GetEnvOrDefault("HANDOFF_SOCKET", "");
+    opt.handoff_wait_sec = std::max(0, std::atoi(GetEnvOrDefault("HANDOFF_WAIT_SEC", "20").c_str()));
+    {
+        char host[256] = {0};
+        gethostname(host, sizeof(host) - 1);
+        opt.reader_id = GetEnvOrDefault("READER_ID", std::string(host) + "-" + std::to_string(getpid()));
+    }
+    StagedLoadOptions& load_opt = opt.load;
+    load_opt.backend = LoadBackendFromEnv();
+    load_opt.prefetch = PrefetchFromEnv();
+    load_opt.residency_budget =
+        std::strtoull(GetEnvOrDefault("RESIDENCY_BUDGET_MB", "0").c_str(), nullptr, 10) << 20;
+    load_opt.verify_checksum = GetEnvOrDefault("VERIFY_CHECKSUM", "0") == "1";
+    load_opt.verify_segments = GetEnvOrDefault("VERIFY_SEGMENTS", "1") != "0";
+    load_opt.share_wait_sec = std::max(1, std::atoi(GetEnvOrDefault("SHARE_WAIT_SEC", "120").c_str()));
+    load_opt.handoff = !opt.handoff_socket.empty();
+    load_opt.promote_residency =
+        std::min(100.0, std::max(0.0, std::atof(GetEnvOrDefault("PROMOTE_RESIDENCY_PCT", "95").c_str()))) / 100.0;
+    TableSnapshot snapshot;
+    ServeOptions serve_opt;
+    serve_opt.socket = serve_socket;
+    serve_opt.threads = DefaultThreads("SERVE_THREADS");
+    serve_opt.batch = std::max(1, std::atoi(GetEnvOrDefault("SERVE_BATCH", "64").c_str()));
+    serve_opt.wait_socket = !opt.handoff_socket.empty();   // 重启交接时前任 drain 完才释放 socket
+    LookupServer server(snapshot, serve_opt);
+    if (!serve_socket.empty() && !server.Start()) return EXIT_FAILURE;
+    ManifestWatchLoop(manifest, opt, running, snapshot);
+    server.Stop();
     return EXIT_SUCCESS;
 }
 
+static StorageSimOptions StorageSimFromEnv() {
+    StorageSimOptions o;
+    o.path = GetEnvOrDefault("STORAGE_SIM_PATH", "");
+    o.latency_us = std::strtoull(GetEnvOrDefault("SIM_LATENCY_US", "2000").c_str(), nullptr, 10);
+    o.bandwidth_bps = std::strtoull(GetEnvOrDefault("SIM_BANDWIDTH_MBPS", "0").c_str(), nullptr, 10) << 20;
+    o.request_bytes = std::strtoull(GetEnvOrDefault("SIM_REQUEST_KB", "128").c_str(), nullptr, 10) << 10;
+    o.fault_bytes = std::strtoull(GetEnvOrDefault("SIM_FAULT_KB", "4").c_str(), nullptr, 10) << 10;
+    o.inflight = std::strtoul(GetEnvOrDefault("SIM_INFLIGHT", "0").c_str(), nullptr, 10);
+    return o;
+}
+
 int main(int argc, char* argv[]) {
     SPD_LOG_INFO(" starting args_count={} {}", argc, (argc>1?argv[1]:"(none)"));
+    FileAccess::Configure(StorageSimFromEnv());
     std::string mode = (argc > 1) ? argv[1] : "";
     if (mode == "writer-loop") {
         return WriterLoop();
-    } else if (mode == "watch") {
+    } else if (mode == "watch" || mode == "serve") {
         // Allow omission of manifest path -> derive from MODEL_BASE
         std::string manifest;
         if (argc >= 3) {
@@ -362,17 +5726,41 @@ int main(int argc, char* argv[]) {
             SPD_LOG_INFO(" no manifest arg, fallback {}", manifest);
         }
         int interval = 5;
-        if (argc >= 4) {
+        if (argc >= 4 && mode == "watch") {
             interval = std::max(1, std::atoi(argv[3]));
         } else {
             interval = std::max(1, std::atoi(GetEnvOrDefault("WATCH_INTERVAL_SEC","5").c_str()));
         }
+        if (mode == "serve") {
+            // serve [manifest_path] [socket]: watch + 查询服务
+            std::string socket = argc >= 4 ? argv[3] : GetEnvOrDefault("SERVE_SOCKET", "/tmp/frozen_kv.sock");
+            SPD_LOG_INFO(" serve mode manifest={} socket={}", manifest, socket);
+            return ReaderWatch(manifest, interval, socket);
+        }
         SPD_LOG_INFO(" watch mode manifest={} interval={}s", manifest, interval);
         return ReaderWatch(manifest, interval);
+    } else if (mode == "build") {
+        if (argc < 4) {
+            std::cerr << "Usage: " << argv[0] << " build <input.tsv> <output> [model_id] [model_version]\n";
+            return EXIT_FAILURE;
+        }
+        uint32_t model_id = (argc >= 5) ? std::strtoul(argv[4], nullptr, 10) : 1;
+        uint32_t model_version = (argc >= 6) ? std::strtoul(argv[5], nullptr, 10) : 1;
+        return BuildFrozenTable(argv[2], argv[3], model_id, model_version) ? EXIT_SUCCESS : EXIT_FAILURE;
+    } else if (mode == "bench-lookup") {
+        uint32_t keys  = (argc >= 3) ? std::strtoul(argv[2], nullptr, 10) : (1u << 24);
+        uint32_t batch = (argc >= 4) ? std::strtoul(argv[3], nullptr, 10) : 256;
+        return BenchLookup(keys, batch);
+    } else if (mode == "bench") {
+        return BenchSuite(argc >= 3 ? argv[2] : "");
     } else {
         std::cerr << "Usage:\n"
                   << "  " << argv[0] << " writer-loop\n"
-                  << "  " << argv[0] << " watch [manifest_path] [interval_sec]\n";
+                  << "  " << argv[0] << " watch [manifest_path] [interval_sec]\n"
+                  << "  " << argv[0] << " serve [manifest_path] [socket]\n"
+                  << "  " << argv[0] << " build <input.tsv> <output> [model_id] [model_version]\n"
+                  << "  " << argv[0] << " bench-lookup [keys] [batch]\n"
+                  << "  " << argv[0] << " bench [out.json]\n";
         return EXIT_FAILURE;
     }
 }